@@ -21,7 +21,7 @@ else
         echo "You are not on a x86_64 machine, please install raylib 5.0.0 and make sure that pkg-config can find it."
         RAYLIB="$(pkg-config --libs --cflags "raylib")"
     fi
-    SRC="./src/main.c ./src/musializer.c ./src/fft.c"
+    SRC="./src/main.c ./src/musializer.c ./src/fft.c ./src/spectrum.c ./src/filterbank.c ./src/autogain.c ./src/envelope.c ./src/onset.c ./src/chroma.c ./src/loudness.c ./src/descriptors.c ./src/peaks.c ./src/ring.c ./src/triple.c ./src/decimator.c ./src/pcm.c ./src/preroll.c ./src/timing.c ./src/realtime.c ./src/chain.c"
 fi
 
 
@@ -34,3 +34,58 @@ LFLAGS_TEST="-lm"
 
 # shellcheck disable=SC2086
 cc ./src/fft.c ./src/fft_test.c -o ./build/fft_test $CFLAGS_TEST $LFLAGS_TEST
+
+# shellcheck disable=SC2086
+cc ./src/spectrum.c ./src/spectrum_test.c -o ./build/spectrum_test $CFLAGS_TEST $LFLAGS_TEST
+
+# shellcheck disable=SC2086
+cc ./src/ring.c ./src/ring_test.c -o ./build/ring_test $CFLAGS_TEST $LFLAGS_TEST -lpthread
+
+# shellcheck disable=SC2086
+cc ./src/triple.c ./src/triple_test.c -o ./build/triple_test $CFLAGS_TEST $LFLAGS_TEST -lpthread
+
+# shellcheck disable=SC2086
+cc ./src/decimator.c ./src/decimator_test.c -o ./build/decimator_test $CFLAGS_TEST $LFLAGS_TEST
+
+# shellcheck disable=SC2086
+cc ./src/pcm.c ./src/pcm_test.c -o ./build/pcm_test $CFLAGS_TEST $LFLAGS_TEST -lpthread
+
+# The pre-roll is decoded by raylib
+if [ "$(uname -m)" = "x86_64" ]; then
+    RAYLIB_TEST="-I ./raylib-5.0_linux_amd64/include/ -L./raylib-5.0_linux_amd64/lib -l:libraylib.a -ldl"
+else
+    RAYLIB_TEST="$(pkg-config --libs --cflags "raylib")"
+fi
+
+# shellcheck disable=SC2086
+cc ./src/preroll.c ./src/timing.c ./src/preroll_test.c -o ./build/preroll_test $CFLAGS_TEST $RAYLIB_TEST $LFLAGS_TEST -lpthread
+
+# shellcheck disable=SC2086
+cc ./src/timing.c ./src/timing_test.c -o ./build/timing_test $CFLAGS_TEST $LFLAGS_TEST -lpthread
+
+# shellcheck disable=SC2086
+cc ./src/realtime.c ./src/realtime_test.c -o ./build/realtime_test $CFLAGS_TEST $LFLAGS_TEST -lpthread
+
+# shellcheck disable=SC2086
+cc ./src/ring.c ./src/timing.c ./src/chain.c ./src/chain_test.c -o ./build/chain_test $CFLAGS_TEST $LFLAGS_TEST -lpthread
+
+# shellcheck disable=SC2086
+cc ./src/autogain.c ./src/autogain_test.c -o ./build/autogain_test $CFLAGS_TEST $LFLAGS_TEST
+
+# shellcheck disable=SC2086
+cc ./src/onset.c ./src/onset_test.c -o ./build/onset_test $CFLAGS_TEST $LFLAGS_TEST
+
+# shellcheck disable=SC2086
+cc ./src/envelope.c ./src/envelope_test.c -o ./build/envelope_test $CFLAGS_TEST $LFLAGS_TEST
+
+# shellcheck disable=SC2086
+cc ./src/fft.c ./src/spectrum.c ./src/peaks.c ./src/peaks_test.c -o ./build/peaks_test $CFLAGS_TEST $LFLAGS_TEST
+
+# shellcheck disable=SC2086
+cc ./src/chroma.c ./src/timing.c ./src/chroma_test.c -o ./build/chroma_test $CFLAGS_TEST $LFLAGS_TEST
+# shellcheck disable=SC2086
+cc ./src/loudness.c ./src/loudness_test.c -o ./build/loudness_test $CFLAGS_TEST $LFLAGS_TEST
+# shellcheck disable=SC2086
+cc ./src/spectrum.c ./src/filterbank.c ./src/filterbank_test.c -o ./build/filterbank_test $CFLAGS_TEST $LFLAGS_TEST
+# shellcheck disable=SC2086
+cc ./src/spectrum.c ./src/descriptors.c ./src/descriptors_test.c -o ./build/descriptors_test $CFLAGS_TEST $LFLAGS_TEST
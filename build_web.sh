@@ -7,8 +7,10 @@ rm -f build/{*.wasm,*.js,*.html}
 mkdir -p build/
 
 emcc -o build/musializer.js \
-  ./src/main.c ./src/musializer.c ./src/fft.c \
-  -Os -Wall \
+  ./src/main.c ./src/musializer.c ./src/fft.c ./src/spectrum.c ./src/filterbank.c \
+  ./src/autogain.c ./src/envelope.c ./src/onset.c ./src/chroma.c ./src/loudness.c \
+  ./src/descriptors.c ./src/peaks.c ./src/ring.c ./src/triple.c ./src/decimator.c ./src/pcm.c ./src/preroll.c ./src/timing.c ./src/realtime.c ./src/chain.c \
+  -Os -Wall -msimd128 \
   -lm -lpthread -ldl \
   -I ./raylib-5.0_wasm/include/ -L./raylib-5.0_wasm/lib -l:libraylib.a \
   -sUSE_GLFW=3 -sASYNCIFY -sMODULARIZE=1 -sEXPORT_ES6=1 -sEXPORT_NAME=createMusializer \
@@ -20,4 +20,4 @@ LFLAGS="-lpthread -lm $RAYLIB_LFLAGS"
 cc -c -o ./build/musializer.o ./src/musializer.c $CFLAGS -fPIC
 
 # shellcheck disable=SC2086
-cc -o ./build/libmusializer.so ./build/musializer.o ./src/fft.c $CFLAGS $LFLAGS -shared
+cc -o ./build/libmusializer.so ./build/musializer.o ./src/fft.c ./src/spectrum.c ./src/filterbank.c ./src/autogain.c ./src/envelope.c ./src/onset.c ./src/chroma.c ./src/loudness.c ./src/descriptors.c ./src/peaks.c ./src/ring.c ./src/triple.c ./src/decimator.c ./src/pcm.c ./src/preroll.c ./src/timing.c ./src/realtime.c ./src/chain.c $CFLAGS $LFLAGS -fPIC -shared
@@ -0,0 +1,58 @@
+#include "autogain.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+
+void autoGainInit(AutoGain *ag, const float windowSeconds,
+                  const float decaySeconds) {
+  assert(windowSeconds > 0.0f && "The window must not be empty");
+  ag->windowSeconds = windowSeconds;
+  ag->decaySeconds = decaySeconds;
+  ag->head = 0;
+  ag->count = 0;
+  ag->gain = 0.0f;
+  ag->lastTime = 0.0;
+}
+
+static inline AutoGainSample *back(AutoGain *ag) {
+  return &ag->samples[(ag->head + ag->count - 1) % AUTO_GAIN_CAPACITY];
+}
+
+static inline void popFront(AutoGain *ag) {
+  ag->head = (ag->head + 1) % AUTO_GAIN_CAPACITY;
+  --ag->count;
+}
+
+float autoGainUpdate(AutoGain *ag, const float value, const double time) {
+  const bool first = ag->count == 0;
+
+  // Smaller or equal values before this one can never be the maximum again
+  while (ag->count > 0 && back(ag)->value <= value)
+    --ag->count;
+
+  // The larger value before this one stands in for it until the slot ends
+  const double slot = ag->windowSeconds / AUTO_GAIN_SLOTS;
+  if (ag->count > 0 && floor(back(ag)->time / slot) == floor(time / slot)) {
+    back(ag)->time = time;
+  } else {
+    if (ag->count == AUTO_GAIN_CAPACITY)
+      popFront(ag); // only if the times went backwards
+    ++ag->count;
+    *back(ag) = (AutoGainSample){.time = time, .value = value};
+  }
+
+  // Expire everything older than the window, the new value always stays
+  while (ag->samples[ag->head].time <= time - ag->windowSeconds)
+    popFront(ag);
+
+  const float windowMax = ag->samples[ag->head].value;
+  if (first || ag->decaySeconds <= 0.0f) {
+    ag->gain = windowMax;
+  } else {
+    const float decayed =
+        ag->gain * expf(-(float)(time - ag->lastTime) / ag->decaySeconds);
+    ag->gain = decayed > windowMax ? decayed : windowMax;
+  }
+  ag->lastTime = time;
+  return ag->gain;
+}
@@ -0,0 +1,45 @@
+#ifndef AUTOGAIN_H
+#define AUTOGAIN_H
+
+#include <stddef.h>
+
+// Candidates kept in the deque. The window is cut into AUTO_GAIN_CAPACITY - 2
+// slots that keep one candidate each, so the deque never fills up however
+// often it is updated.
+#define AUTO_GAIN_CAPACITY 1024
+#define AUTO_GAIN_SLOTS (AUTO_GAIN_CAPACITY - 2)
+
+typedef struct {
+  double time;
+  float value;
+} AutoGainSample;
+
+// Sliding-window peak tracker. The candidates form a monotonic deque: their
+// values strictly decrease from front to back, so the front is the maximum
+// of the window. An update pushes one value and pops what can never be the
+// maximum again, which is O(1) amortized. A candidate that lands in the
+// slot of the one before it replaces that one's time instead of being
+// appended, so a maximum may outlast the window by up to one slot
+// (windowSeconds / AUTO_GAIN_SLOTS) but never leaves it early.
+//
+// With decaySeconds > 0 the gain does not jump down when a peak leaves the
+// window but decays exponentially towards the window maximum.
+typedef struct {
+  float windowSeconds;
+  float decaySeconds;
+  AutoGainSample samples[AUTO_GAIN_CAPACITY]; // ring buffer, front at head
+  size_t head;
+  size_t count;
+  float gain;
+  double lastTime;
+} AutoGain;
+
+void autoGainInit(AutoGain *ag, const float windowSeconds,
+                  const float decaySeconds);
+
+// Adds `value` observed at `time` seconds (non-decreasing between calls) and
+// returns the current gain: the window maximum, or the decayed previous
+// gain if that is larger.
+float autoGainUpdate(AutoGain *ag, const float value, const double time);
+
+#endif // AUTOGAIN_H
@@ -0,0 +1,62 @@
+#include "autogain.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+#define WINDOW_SECONDS 5.0f
+#define RATE 375.0 // updates per second, 48 kHz at the smallest hop
+#define SECONDS 12.0
+
+// Falls by one per second, never twice the same value
+static float decay(const double time) { return 1000.0f - time; }
+
+int main(void) {
+  int failed = 0;
+  AutoGain ag;
+
+  // A release that falls for longer than the deque holds updates: the gain
+  // is the value from a window ago, give or take a slot, all the way down
+  autoGainInit(&ag, WINDOW_SECONDS, 0.0f);
+  const double slot = WINDOW_SECONDS / AUTO_GAIN_SLOTS;
+  unsigned long early = 0, late = 0;
+  for (unsigned long i = 0; i < SECONDS * RATE; ++i) {
+    const double time = i / RATE;
+    const float gain = autoGainUpdate(&ag, decay(time), time);
+    const double oldest = time - WINDOW_SECONDS + 1.0 / RATE;
+    const float expected = decay(oldest > 0.0 ? oldest : 0.0);
+    if (gain < expected - 1e-3f)
+      ++early;
+    if (gain > decay(oldest - slot > 0.0 ? oldest - slot : 0.0) + 1e-3f)
+      ++late;
+  }
+  printf("%.0f updates: %lu collapsed early, %lu held too long, %zu "
+         "candidates\n",
+         SECONDS * RATE, early, late, ag.count);
+  failed |= early > 0 || late > 0 || ag.count >= AUTO_GAIN_CAPACITY;
+
+  // A peak holds for the window and is gone after it
+  autoGainInit(&ag, WINDOW_SECONDS, 0.0f);
+  autoGainUpdate(&ag, 2.0f, 0.0);
+  float held = 0.0f, gone = 0.0f;
+  for (unsigned long i = 1; i < 10 * RATE; ++i) {
+    const double time = i / RATE;
+    const float gain = autoGainUpdate(&ag, 1.0f, time);
+    if (time < WINDOW_SECONDS - 0.01)
+      held = gain;
+    else if (time > WINDOW_SECONDS + 0.01)
+      gone = gain;
+  }
+  printf("peak: %.1f within the window, %.1f after it\n", held, gone);
+  failed |= held != 2.0f || gone != 1.0f;
+
+  // With a decay the gain falls off smoothly once the peak left the window:
+  // from 1 at 0.5 s to exp(-1.5 / 2) at 2 s
+  autoGainInit(&ag, 1.0f, 2.0f);
+  autoGainUpdate(&ag, 1.0f, 0.0);
+  autoGainUpdate(&ag, 0.0f, 0.5);
+  const float decayed = autoGainUpdate(&ag, 0.0f, 2.0);
+  printf("decayed: %.3f\n", decayed);
+  failed |= decayed < 0.47f || decayed > 0.48f;
+
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
@@ -0,0 +1,169 @@
+#include "chain.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+bool chainInit(ProcessorChain *chain, const size_t channels,
+               const size_t blockFrames, const size_t queueFrames) {
+  memset(chain, 0, sizeof(*chain));
+  if (channels == 0 || blockFrames == 0 || queueFrames == 0)
+    return false;
+  const size_t kept =
+      channels < RING_MAX_CHANNELS ? channels : RING_MAX_CHANNELS;
+  chain->channels = channels;
+  chain->blockFrames = blockFrames;
+  chain->block = malloc(blockFrames * channels * sizeof(float));
+  chain->queueSamples = malloc(queueFrames * kept * sizeof(float));
+  chain->workerBlock = malloc(blockFrames * channels * sizeof(float));
+  chain->workerChannel = malloc(blockFrames * sizeof(float));
+  if (chain->block == NULL || chain->queueSamples == NULL ||
+      chain->workerBlock == NULL || chain->workerChannel == NULL ||
+      !ringInit(&chain->queue, chain->queueSamples, queueFrames, channels)) {
+    chainFree(chain);
+    return false;
+  }
+  return true;
+}
+
+void chainFree(ProcessorChain *chain) {
+  chainStop(chain);
+  free(chain->block);
+  free(chain->queueSamples);
+  free(chain->workerBlock);
+  free(chain->workerChannel);
+  chain->block = NULL;
+  chain->queueSamples = NULL;
+  chain->workerBlock = NULL;
+  chain->workerChannel = NULL;
+  chain->count = 0;
+}
+
+bool chainAdd(ProcessorChain *chain, const char *name, ChainProcess process,
+              void *context, const bool offThread, CallTiming *timing) {
+  if (chain->count == CHAIN_MAX_STAGES)
+    return false;
+  chain->stages[chain->count++] = (ChainStage){
+      .name = name,
+      .process = process,
+      .context = context,
+      .offThread = offThread,
+      .timing = timing,
+  };
+  return true;
+}
+
+static void runStages(ProcessorChain *chain, const bool offThread,
+                      float samples[], const size_t frames,
+                      const double time) {
+  for (size_t i = 0; i < chain->count; ++i) {
+    const ChainStage *stage = &chain->stages[i];
+    if (stage->offThread != offThread)
+      continue;
+    const uint64_t start = stage->timing != NULL ? timingNow() : 0;
+    stage->process(stage->context, samples, frames, time);
+    if (stage->timing != NULL)
+      callTimingRecord(stage->timing, start, timingNow(), frames);
+  }
+}
+
+static void skipped(ProcessorChain *chain) {
+  for (size_t i = 0; i < chain->count; ++i)
+    if (chain->stages[i].offThread && chain->stages[i].timing != NULL)
+      callTimingUnderrun(chain->stages[i].timing);
+}
+
+// Interleaves [start, start + frames) of the ring into the worker's block
+static bool readQueue(ProcessorChain *chain, const uint64_t start,
+                      const size_t frames) {
+  const size_t channels = chain->channels;
+  for (size_t c = 0; c < channels; ++c) {
+    if (!ringReadChannel(&chain->queue, c, start, frames,
+                         chain->workerChannel))
+      return false;
+    for (size_t i = 0; i < frames; ++i)
+      chain->workerBlock[i * channels + c] = chain->workerChannel[i];
+  }
+  return true;
+}
+
+static void *chainWorker(void *arg) {
+  ProcessorChain *chain = arg;
+  const struct timespec idle = {.tv_sec = 0,
+                                .tv_nsec = CHAIN_IDLE_MICROSECONDS * 1000};
+  uint64_t next = 0;
+  while (atomic_load_explicit(&chain->running, memory_order_acquire)) {
+    const uint64_t written = ringWritten(&chain->queue);
+    if (next == written) {
+      nanosleep(&idle, NULL);
+      continue;
+    }
+    const uint64_t oldest = ringOldest(&chain->queue);
+    if (next < oldest) {
+      skipped(chain);
+      next = oldest;
+    }
+    const size_t frames = written - next < chain->blockFrames
+                              ? written - next
+                              : chain->blockFrames;
+    // Overwritten while it was read
+    if (!readQueue(chain, next, frames)) {
+      skipped(chain);
+      next = ringOldest(&chain->queue);
+      continue;
+    }
+    RingStamp stamp;
+    const double time =
+        ringLatestStamp(&chain->queue, &stamp) ? stamp.time : 0.0;
+    runStages(chain, true, chain->workerBlock, frames, time);
+    next += frames;
+    ringConsume(&chain->queue, next);
+  }
+  return NULL;
+}
+
+bool chainStart(ProcessorChain *chain) {
+  chainStop(chain);
+  bool offThread = false;
+  for (size_t i = 0; i < chain->count; ++i)
+    offThread |= chain->stages[i].offThread;
+  if (!offThread)
+    return true;
+  if (chain->channels > RING_MAX_CHANNELS)
+    return false;
+  ringReset(&chain->queue);
+  atomic_store_explicit(&chain->running, true, memory_order_release);
+  if (pthread_create(&chain->worker, NULL, chainWorker, chain) != 0) {
+    atomic_store_explicit(&chain->running, false, memory_order_release);
+    return false;
+  }
+  chain->threaded = true;
+  return true;
+}
+
+void chainStop(ProcessorChain *chain) {
+  if (!chain->threaded)
+    return;
+  atomic_store_explicit(&chain->running, false, memory_order_release);
+  pthread_join(chain->worker, NULL);
+  chain->threaded = false;
+}
+
+void chainProcess(ProcessorChain *chain, const float samples[],
+                  size_t frames, const double time) {
+  while (frames > 0) {
+    const size_t piece =
+        frames < chain->blockFrames ? frames : chain->blockFrames;
+    memcpy(chain->block, samples, piece * chain->channels * sizeof(float));
+    runStages(chain, false, chain->block, piece, time);
+    if (chain->threaded)
+      ringWrite(&chain->queue, chain->block, piece, time);
+    else
+      runStages(chain, true, chain->block, piece, time);
+    samples += piece * chain->channels;
+    frames -= piece;
+  }
+}
+
+uint64_t chainSkippedFrames(const ProcessorChain *chain) {
+  return ringStats(&chain->queue).droppedFrames;
+}
@@ -0,0 +1,88 @@
+#ifndef CHAIN_H
+#define CHAIN_H
+
+#include "ring.h"
+#include "timing.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CHAIN_MAX_STAGES 8
+#define CHAIN_IDLE_MICROSECONDS 1000 // how long the worker waits for frames
+
+// Processes a block of interleaved frames that were produced at `time`
+// seconds (of any monotonic clock). It may change the samples for the
+// stages after it.
+typedef void (*ChainProcess)(void *context, float samples[], size_t frames,
+                             double time);
+
+typedef struct {
+  const char *name;
+  ChainProcess process;
+  void *context;
+  bool offThread;
+  CallTiming *timing; // of the calls of process, may be NULL
+} ChainStage;
+
+// The stages an audio callback hands its blocks to. chainProcess copies the
+// block into a buffer of the chain, in pieces of at most `blockFrames`, and
+// runs the stages on it in the order they were added. Nothing is allocated
+// after chainInit.
+//
+// Stages that are off the thread get the pieces, as the stages on it left
+// them, through a ring that a worker reads, so the callback only pays for
+// the copy. The worker reads whatever was written since its last read, at
+// most `blockFrames` at a time, and stamps it with the time of the newest
+// write. Frames the worker did not get to before they were overwritten are
+// skipped and counted as an underrun of every stage off the thread.
+//
+// Stages off the thread run on the calling thread after the others while the
+// worker is not running: before chainStart, without threads, or with more
+// channels than the ring keeps (RING_MAX_CHANNELS).
+typedef struct {
+  ChainStage stages[CHAIN_MAX_STAGES];
+  size_t count;
+  size_t channels;    // interleaved in a block
+  size_t blockFrames; // of block and workerBlock
+  float *block;       // the caller's copy
+
+  Ring queue; // to the worker
+  float *queueSamples;
+  float *workerBlock;
+  float *workerChannel; // read from the ring before it is interleaved
+  pthread_t worker;
+  bool threaded;
+  _Atomic bool running;
+} ProcessorChain;
+
+// Allocates the buffers for blocks of `channels` and a ring of `queueFrames`
+// (a power of two) for the worker, without stages. Fails if either size is
+// 0 or out of memory.
+bool chainInit(ProcessorChain *chain, const size_t channels,
+               const size_t blockFrames, const size_t queueFrames);
+
+// Stops the worker and frees the buffers.
+void chainFree(ProcessorChain *chain);
+
+// Appends a stage. Only while the chain is not running. Fails if there are
+// CHAIN_MAX_STAGES already.
+bool chainAdd(ProcessorChain *chain, const char *name, ChainProcess process,
+              void *context, const bool offThread, CallTiming *timing);
+
+// Starts the worker if a stage is off the thread, on a fresh ring. Fails if
+// that does not work, and the stages run on the calling thread instead.
+bool chainStart(ProcessorChain *chain);
+
+// Stops the worker, which takes up to CHAIN_IDLE_MICROSECONDS plus one run
+// of the stages off the thread.
+void chainStop(ProcessorChain *chain);
+
+// The callback side. Runs the stages on `frames` interleaved frames.
+void chainProcess(ProcessorChain *chain, const float samples[],
+                  size_t frames, const double time);
+
+// Frames the stages off the thread skipped since chainStart.
+uint64_t chainSkippedFrames(const ProcessorChain *chain);
+
+#endif // CHAIN_H
@@ -0,0 +1,140 @@
+#include "chain.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CHANNELS 2
+#define BLOCK_FRAMES 64
+#define QUEUE_FRAMES 4096
+#define CALLBACK_FRAMES 100 // split into pieces of BLOCK_FRAMES
+#define CALLBACKS 1000
+
+typedef struct {
+  _Atomic uint64_t frames;
+  double sum; // of the left channel
+  bool ordered;
+} Tap;
+
+static void twice(void *context, float samples[], size_t frames,
+                  double time) {
+  (void)context;
+  (void)time;
+  for (size_t i = 0; i < frames * CHANNELS; ++i)
+    samples[i] *= 2.0f;
+}
+
+// Sees the frames in the order they were written: frame i is i, doubled
+static void tap(void *context, float samples[], size_t frames, double time) {
+  (void)time;
+  Tap *t = context;
+  const uint64_t first =
+      atomic_load_explicit(&t->frames, memory_order_relaxed);
+  for (size_t i = 0; i < frames; ++i) {
+    t->sum += samples[i * CHANNELS];
+    t->ordered &= samples[i * CHANNELS] == 2.0f * ((first + i) % 1000) &&
+                  samples[i * CHANNELS + 1] == -samples[i * CHANNELS];
+  }
+  atomic_store_explicit(&t->frames, first + frames, memory_order_release);
+}
+
+static void slow(void *context, float samples[], size_t frames, double time) {
+  (void)samples;
+  (void)time;
+  const struct timespec pause = {.tv_sec = 0, .tv_nsec = 1000000};
+  nanosleep(&pause, NULL);
+  atomic_fetch_add((_Atomic uint64_t *)context, frames);
+}
+
+static float input[CALLBACKS * CALLBACK_FRAMES * CHANNELS];
+
+// Frame i is i % 1000 on the left and its negation on the right
+static void feed(ProcessorChain *chain, const bool paced) {
+  const struct timespec period = {.tv_sec = 0, .tv_nsec = 500000};
+  for (size_t c = 0; c < CALLBACKS; ++c) {
+    chainProcess(chain, &input[c * CALLBACK_FRAMES * CHANNELS],
+                 CALLBACK_FRAMES, c * 0.001);
+    if (paced)
+      nanosleep(&period, NULL);
+  }
+}
+
+static bool tapIs(Tap *t, const char *name, const double expectedSum) {
+  const uint64_t frames = atomic_load(&t->frames);
+  printf("%s: %lu frames, sum %.0f, %s\n", name, (unsigned long)frames,
+         t->sum, t->ordered ? "in order" : "OUT OF ORDER");
+  return frames == CALLBACKS * CALLBACK_FRAMES && t->sum == expectedSum &&
+         t->ordered;
+}
+
+int main(void) {
+  int failed = 0;
+  double expectedSum = 0.0;
+  for (size_t i = 0; i < CALLBACKS * CALLBACK_FRAMES; ++i) {
+    input[i * CHANNELS] = i % 1000;
+    input[i * CHANNELS + 1] = -(float)(i % 1000);
+    expectedSum += 2.0 * (i % 1000);
+  }
+
+  ProcessorChain chain = {0};
+  if (!chainInit(&chain, CHANNELS, BLOCK_FRAMES, QUEUE_FRAMES)) {
+    fprintf(stderr, "Could not allocate the chain\n");
+    return EXIT_FAILURE;
+  }
+
+  // In order on the calling thread, also the stage for the worker before
+  // the worker runs. The caller's frames stay as they are.
+  Tap before = {.ordered = true}, after = {.ordered = true};
+  CallTiming timing;
+  callTimingReset(&timing);
+  chainAdd(&chain, "twice", twice, NULL, false, NULL);
+  chainAdd(&chain, "after", tap, &after, true, NULL);
+  chainAdd(&chain, "before", tap, &before, false, &timing);
+  feed(&chain, false);
+  failed |= !tapIs(&before, "on the thread", expectedSum);
+  failed |= !tapIs(&after, "not started", expectedSum);
+  failed |= input[2 * CHANNELS] != 2.0f;
+  // 100 frames are a piece of 64 and one of 36
+  const HistogramSummary pieces = histogramSummary(&timing.frames);
+  printf("%lu pieces of at most %lu frames\n", (unsigned long)pieces.count,
+         (unsigned long)pieces.max);
+  failed |= pieces.count != 2 * CALLBACKS || pieces.max != BLOCK_FRAMES;
+
+  // Everything arrives at the worker if it keeps up
+  chainStop(&chain);
+  chain.count = 0;
+  Tap worker = {.ordered = true};
+  callTimingReset(&timing);
+  chainAdd(&chain, "twice", twice, NULL, false, NULL);
+  chainAdd(&chain, "worker", tap, &worker, true, &timing);
+  failed |= !chainStart(&chain);
+  feed(&chain, true);
+  while (atomic_load(&worker.frames) < CALLBACKS * CALLBACK_FRAMES &&
+         chainSkippedFrames(&chain) == 0)
+    ;
+  chainStop(&chain);
+  failed |= !tapIs(&worker, "on the worker", expectedSum);
+  failed |= chainSkippedFrames(&chain) != 0;
+  failed |= atomic_load(&timing.underruns) != 0;
+
+  // A worker that falls behind skips frames, the callback goes on
+  chain.count = 0;
+  _Atomic uint64_t slowFrames = 0;
+  callTimingReset(&timing);
+  chainAdd(&chain, "slow", slow, &slowFrames, true, &timing);
+  failed |= !chainStart(&chain);
+  feed(&chain, false);
+  while (atomic_load(&slowFrames) == 0)
+    ;
+  chainStop(&chain);
+  const uint64_t skipped = chainSkippedFrames(&chain);
+  printf("slow worker: %lu frames, %lu skipped, %lu underruns\n",
+         (unsigned long)atomic_load(&slowFrames), (unsigned long)skipped,
+         (unsigned long)atomic_load(&timing.underruns));
+  failed |= skipped == 0 || atomic_load(&timing.underruns) == 0;
+  failed |= atomic_load(&slowFrames) + skipped > CALLBACKS * CALLBACK_FRAMES;
+
+  chainFree(&chain);
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
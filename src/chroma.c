@@ -0,0 +1,137 @@
+#include "chroma.h"
+#include <math.h>
+#include <stdio.h>
+
+// https://pages.mtu.edu/~suits/NoteFreqCalcs.html
+#define A4_HZ 440.0f
+#define A4_MIDI 69
+#define EQUAL_TEMPERED_HALF_STEP 1.059463094359f
+
+static const float MAJOR_PROFILE[CHROMA_PITCH_CLASSES] = {
+    6.35f, 2.23f, 3.48f, 2.33f, 4.38f, 4.09f,
+    2.52f, 5.19f, 2.39f, 3.66f, 2.29f, 2.88f};
+static const float MINOR_PROFILE[CHROMA_PITCH_CLASSES] = {
+    6.33f, 2.68f, 3.52f, 5.38f, 2.60f, 3.53f,
+    2.54f, 4.75f, 3.98f, 2.69f, 3.34f, 3.17f};
+
+static const char *PITCH_NAMES[CHROMA_PITCH_CLASSES] = {
+    "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
+
+const char *chromaPitchName(const int pitchClass) {
+  if (pitchClass < 0 || pitchClass >= CHROMA_PITCH_CLASSES)
+    return "?";
+  return PITCH_NAMES[pitchClass];
+}
+
+// Band whose center is closest to hz, or -1 if hz is below the first band
+static int nearestBand(const float centerHz[], const size_t n,
+                       const float hz) {
+  if (n == 0 || hz < centerHz[0] / EQUAL_TEMPERED_HALF_STEP)
+    return -1;
+  size_t lo = 0, hi = n - 1;
+  while (lo < hi) { // first band with a center >= hz
+    const size_t mid = (lo + hi) / 2;
+    if (centerHz[mid] < hz)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo > 0 && hz - centerHz[lo - 1] < centerHz[lo] - hz)
+    --lo;
+  return lo;
+}
+
+bool chromaMapInit(ChromaMap *map, const float centerHz[], const size_t n) {
+  if (n > CHROMA_MAX_BANDS) {
+    fprintf(stderr, "Chroma supports at most %d bands, got %zu\n",
+            CHROMA_MAX_BANDS, n);
+    map->bands = 0;
+    return false;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    const float hz = centerHz[i];
+    if (hz < CHROMA_MIN_HZ || hz > CHROMA_MAX_HZ) {
+      map->pitchClass[i] = -1;
+    } else {
+      const int midi = (int)lroundf(12.0f * log2f(hz / A4_HZ)) + A4_MIDI;
+      map->pitchClass[i] = midi % CHROMA_PITCH_CLASSES;
+    }
+    map->third[i] = nearestBand(centerHz, n, hz / 3.0f);
+    map->fifth[i] = nearestBand(centerHz, n, hz / 5.0f);
+  }
+  map->bands = n;
+  return true;
+}
+
+void chromaCompute(const ChromaMap *map, const float amplitudes[],
+                   const bool suppressHarmonics,
+                   float chroma[CHROMA_PITCH_CLASSES]) {
+  for (int c = 0; c < CHROMA_PITCH_CLASSES; ++c)
+    chroma[c] = 0.0f;
+
+  for (size_t i = 0; i < map->bands; ++i) {
+    if (map->pitchClass[i] < 0)
+      continue;
+    float a = amplitudes[i];
+    if (suppressHarmonics) {
+      if (map->third[i] >= 0)
+        a -= CHROMA_HARMONIC_WEIGHT * amplitudes[map->third[i]];
+      if (map->fifth[i] >= 0)
+        a -= CHROMA_HARMONIC_WEIGHT * amplitudes[map->fifth[i]];
+    }
+    if (a > 0.0f)
+      chroma[(int)map->pitchClass[i]] += a;
+  }
+
+  float m = 0.0f;
+  for (int c = 0; c < CHROMA_PITCH_CLASSES; ++c)
+    m = chroma[c] > m ? chroma[c] : m;
+  if (m > 0.0f)
+    for (int c = 0; c < CHROMA_PITCH_CLASSES; ++c)
+      chroma[c] /= m;
+}
+
+// Pearson correlation of the chroma with a profile rotated to `tonic`
+static float profileCorrelation(const float chroma[CHROMA_PITCH_CLASSES],
+                                const float profile[CHROMA_PITCH_CLASSES],
+                                const int tonic) {
+  float meanC = 0.0f, meanP = 0.0f;
+  for (int c = 0; c < CHROMA_PITCH_CLASSES; ++c) {
+    meanC += chroma[c];
+    meanP += profile[c];
+  }
+  meanC /= CHROMA_PITCH_CLASSES;
+  meanP /= CHROMA_PITCH_CLASSES;
+
+  float cov = 0.0f, varC = 0.0f, varP = 0.0f;
+  for (int c = 0; c < CHROMA_PITCH_CLASSES; ++c) {
+    const float dc = chroma[(c + tonic) % CHROMA_PITCH_CLASSES] - meanC;
+    const float dp = profile[c] - meanP;
+    cov += dc * dp;
+    varC += dc * dc;
+    varP += dp * dp;
+  }
+  return varC > 0.0f ? cov / sqrtf(varC * varP) : 0.0f;
+}
+
+int chromaKey(const float chroma[CHROMA_PITCH_CLASSES], bool *minor) {
+  int key = 0;
+  float best = -2.0f;
+  *minor = false;
+  for (int tonic = 0; tonic < CHROMA_PITCH_CLASSES; ++tonic) {
+    const float major = profileCorrelation(chroma, MAJOR_PROFILE, tonic);
+    const float minorCorrelation =
+        profileCorrelation(chroma, MINOR_PROFILE, tonic);
+    if (major > best) {
+      best = major;
+      key = tonic;
+      *minor = false;
+    }
+    if (minorCorrelation > best) {
+      best = minorCorrelation;
+      key = tonic;
+      *minor = true;
+    }
+  }
+  return key;
+}
@@ -0,0 +1,42 @@
+#ifndef CHROMA_H
+#define CHROMA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CHROMA_PITCH_CLASSES 12
+#define CHROMA_MAX_BANDS 1024
+#define CHROMA_MIN_HZ 55.0f   // A1
+#define CHROMA_MAX_HZ 5000.0f // above that mostly harmonics and noise
+#define CHROMA_HARMONIC_WEIGHT 0.5f
+
+// Maps frequency bands to pitch classes (0 = C, ..., 11 = B). For the
+// optional harmonic suppression it also knows which band holds the
+// fundamental of a band's third and fifth harmonic, the ones that land on
+// other pitch classes (a fifth and a major third up).
+typedef struct {
+  size_t bands;
+  signed char pitchClass[CHROMA_MAX_BANDS]; // -1 outside of the chroma range
+  int third[CHROMA_MAX_BANDS];              // band of f / 3, or -1
+  int fifth[CHROMA_MAX_BANDS];              // band of f / 5, or -1
+} ChromaMap;
+
+// Builds the map for n bands with the given center frequencies, which must
+// increase. Fails if there are more than CHROMA_MAX_BANDS bands.
+bool chromaMapInit(ChromaMap *map, const float centerHz[], const size_t n);
+
+// Folds the linear band amplitudes into a chroma vector normalized to a
+// maximum of one. With suppressHarmonics every band first loses
+// CHROMA_HARMONIC_WEIGHT times the amplitude of the bands that could be its
+// third or fifth harmonic's fundamental. Costs O(bands).
+void chromaCompute(const ChromaMap *map, const float amplitudes[],
+                   const bool suppressHarmonics,
+                   float chroma[CHROMA_PITCH_CLASSES]);
+
+// Estimates the key by correlating the chroma with the Krumhansl-Kessler
+// major and minor profiles. Returns the tonic pitch class.
+int chromaKey(const float chroma[CHROMA_PITCH_CLASSES], bool *minor);
+
+const char *chromaPitchName(const int pitchClass);
+
+#endif // CHROMA_H
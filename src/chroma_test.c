@@ -0,0 +1,130 @@
+#include "chroma.h"
+#include "timing.h"
+#include <math.h>
+#include <stdio.h>
+
+#define SEMITONE_BANDS 100 // from A0, as the bars see the spectrum
+#define A0_HZ 27.5f
+#define HARMONICS 8
+#define TIMED_BANDS 800 // as many as there can be bars
+#define TIMED_HOPS 100000
+#define FRAME_MICROSECONDS (1000000.0 / 60.0)
+
+enum { C, CS, D, DS, E, F, FS, G, GS, A, AS, B };
+
+static ChromaMap MAP;
+static float CENTERS[SEMITONE_BANDS];
+static float TIMED_CENTERS[TIMED_BANDS]; // 20 Hz to 20 kHz
+
+// Adds a note (MIDI number) with `harmonics` partials of falling amplitude
+// to the band nearest to each partial
+static void addNote(float bands[], const int midi, const int harmonics) {
+  const float hz = 440.0f * powf(2.0f, (midi - 69) / 12.0f);
+  for (int h = 1; h <= harmonics; ++h) {
+    const int band = lroundf(12.0f * log2f(h * hz / A0_HZ));
+    if (band >= 0 && band < SEMITONE_BANDS)
+      bands[band] += 1.0f / h;
+  }
+}
+
+// The pitch classes of the largest `n` chroma bins, as a bit set
+static unsigned strongest(const float chroma[], const int n) {
+  unsigned set = 0;
+  for (int i = 0; i < n; ++i) {
+    int best = -1;
+    for (int c = 0; c < CHROMA_PITCH_CLASSES; ++c)
+      if (!(set & 1u << c) && (best < 0 || chroma[c] > chroma[best]))
+        best = c;
+    set |= 1u << best;
+  }
+  return set;
+}
+
+// A triad of pure tones shows its three pitch classes
+static bool chord(const char *name, const int root, const int third,
+                  const int fifth) {
+  float bands[SEMITONE_BANDS] = {0}, chroma[CHROMA_PITCH_CLASSES];
+  addNote(bands, root, 1);
+  addNote(bands, third, 1);
+  addNote(bands, fifth, 1);
+  chromaCompute(&MAP, bands, false, chroma);
+  const unsigned expected =
+      1u << root % 12 | 1u << third % 12 | 1u << fifth % 12;
+  const bool found = strongest(chroma, 3) == expected;
+  printf("%-8s %s\n", name, found ? "found" : "NOT FOUND");
+  return found;
+}
+
+// Chords of a cadence with harmonic-rich tones, all summed up
+static bool key(const char *name, const int chords[][3], const size_t n,
+                const int tonic, const bool minor) {
+  float bands[SEMITONE_BANDS] = {0}, chroma[CHROMA_PITCH_CLASSES];
+  for (size_t i = 0; i < n; ++i)
+    for (int j = 0; j < 3; ++j)
+      addNote(bands, chords[i][j], HARMONICS);
+  chromaCompute(&MAP, bands, true, chroma);
+  bool isMinor;
+  const int estimated = chromaKey(chroma, &isMinor);
+  printf("%-8s %s %s\n", name, chromaPitchName(estimated),
+         isMinor ? "minor" : "major");
+  return estimated == tonic && isMinor == minor;
+}
+
+int main(void) {
+  int failed = 0;
+  for (int b = 0; b < SEMITONE_BANDS; ++b)
+    CENTERS[b] = A0_HZ * powf(2.0f, b / 12.0f);
+  for (int b = 0; b < TIMED_BANDS; ++b)
+    TIMED_CENTERS[b] = 20.0f * powf(1000.0f, (float)b / (TIMED_BANDS - 1));
+  if (!chromaMapInit(&MAP, CENTERS, SEMITONE_BANDS)) {
+    fprintf(stderr, "Could not build the chroma map\n");
+    return 1;
+  }
+
+  failed |= !chord("C", 60, 64, 67);
+  failed |= !chord("A minor", 57, 60, 64);
+  failed |= !chord("F# minor", 66, 69, 73);
+  failed |= !chord("B flat", 58, 62, 65);
+
+  // A tone with eight harmonics is its own pitch class, and suppressing the
+  // harmonics lowers the fifth that its third harmonic adds
+  float bands[SEMITONE_BANDS] = {0}, plain[CHROMA_PITCH_CLASSES],
+        suppressed[CHROMA_PITCH_CLASSES];
+  addNote(bands, 55, HARMONICS); // G3
+  chromaCompute(&MAP, bands, false, plain);
+  chromaCompute(&MAP, bands, true, suppressed);
+  printf("G3 with harmonics: G %.2f, D %.2f, suppressed D %.2f\n", plain[G],
+         plain[D], suppressed[D]);
+  failed |= plain[G] != 1.0f || suppressed[G] != 1.0f ||
+            suppressed[D] >= plain[D];
+
+  const int major[][3] = {{60, 64, 67}, {65, 69, 72}, {67, 71, 74},
+                          {60, 64, 67}};
+  const int minor[][3] = {{57, 60, 64}, {62, 65, 69}, {64, 68, 71},
+                          {57, 60, 64}};
+  failed |= !key("C-F-G-C", major, 4, C, false);
+  failed |= !key("Am-Dm-E-Am", minor, 4, A, true);
+
+  // The cost per hop with as many bands as there can be bars, against a
+  // frame at 60 FPS
+  ChromaMap timed;
+  chromaMapInit(&timed, TIMED_CENTERS, TIMED_BANDS);
+  float amplitudes[TIMED_BANDS], chroma[CHROMA_PITCH_CLASSES];
+  for (int b = 0; b < TIMED_BANDS; ++b)
+    amplitudes[b] = 1.0f + (b * 7919 % 101) / 100.0f;
+  float sink = 0.0f;
+  const uint64_t start = timingNow();
+  for (int hop = 0; hop < TIMED_HOPS; ++hop) {
+    amplitudes[hop % TIMED_BANDS] += 1e-3f;
+    chromaCompute(&timed, amplitudes, true, chroma);
+    sink += chroma[hop % CHROMA_PITCH_CLASSES];
+  }
+  const double perHop = (double)(timingNow() - start) / TIMED_HOPS;
+  printf("chromaCompute: %.2f us per hop of %d bands, %.3f%% of a frame "
+         "(%g)\n",
+         perHop, TIMED_BANDS, 100.0 * perHop / FRAME_MICROSECONDS, sink);
+  failed |= perHop > 0.01 * FRAME_MICROSECONDS;
+
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
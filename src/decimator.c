@@ -0,0 +1,71 @@
+#include "decimator.h"
+#include "simd.h"
+#include <math.h>
+#include <stdio.h>
+
+// Half the transition band of the Blackman window in units of 1 / taps,
+// measured at -70 dB
+#define BLACKMAN_HALF_TRANSITION 2.75f
+
+bool decimatorInit(Decimator *d, const unsigned int factor) {
+  if (factor == 0 || factor > DECIMATOR_MAX_FACTOR) {
+    fprintf(stderr, "Decimation factor must be 1 to %d, got %u\n",
+            DECIMATOR_MAX_FACTOR, factor);
+    return false;
+  }
+  d->factor = factor;
+  d->taps = (size_t)factor * DECIMATOR_TAPS_PER_PHASE;
+  // The stopband starts BLACKMAN_HALF_TRANSITION / taps above the cutoff
+  // and folds back to as far below the output Nyquist frequency
+  d->passband = 1.0f - 2.0f * BLACKMAN_HALF_TRANSITION /
+                           DECIMATOR_TAPS_PER_PHASE;
+
+  const double pi = M_PI;
+  const double cutoff = 0.5 / factor; // cycles per input sample
+  const double center = 0.5 * (d->taps - 1);
+  double h[DECIMATOR_MAX_TAPS];
+  double sum = 0.0;
+  for (size_t k = 0; k < d->taps; ++k) {
+    const double x = k - center;
+    const double sinc =
+        x == 0.0 ? 2.0 * cutoff : sin(2.0 * pi * cutoff * x) / (pi * x);
+    const double phase = 2.0 * pi * k / (d->taps - 1);
+    const double blackman = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2.0 * phase);
+    h[k] = sinc * blackman;
+    sum += h[k];
+  }
+  for (size_t k = 0; k < d->taps; ++k)
+    d->phases[k % factor][k / factor] = h[k] / sum;
+  return true;
+}
+
+size_t decimatorInputSize(const Decimator *d, const size_t n) {
+  return n > 0 ? (n - 1) * d->factor + d->taps : 0;
+}
+
+void decimate(const Decimator *d, const float in[], float out[],
+              const size_t n) {
+  const size_t factor = d->factor;
+  const size_t length = n + DECIMATOR_TAPS_PER_PHASE - 1;
+  float phase[length]; // every factor-th input sample
+
+  for (size_t m = 0; m < n; ++m)
+    out[m] = 0.0f;
+  // out[m] = sum over p, j of phases[p][j] * in[(m + j) * factor + p]
+  for (size_t p = 0; p < factor; ++p) {
+    for (size_t i = 0; i < length; ++i)
+      phase[i] = in[i * factor + p];
+    for (size_t j = 0; j < DECIMATOR_TAPS_PER_PHASE; ++j) {
+      const float tap = d->phases[p][j];
+      const float *x = &phase[j];
+      size_t m = 0;
+#ifdef VF_WIDTH
+      const vf t = vfSet(tap);
+      for (; m + VF_WIDTH <= n; m += VF_WIDTH)
+        vfStore(&out[m], vfAdd(vfLoad(&out[m]), vfMul(t, vfLoad(&x[m]))));
+#endif // VF_WIDTH
+      for (; m < n; ++m)
+        out[m] += tap * x[m];
+    }
+  }
+}
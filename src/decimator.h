@@ -0,0 +1,39 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define DECIMATOR_MAX_FACTOR 8
+#define DECIMATOR_TAPS_PER_PHASE 16
+#define DECIMATOR_MAX_TAPS (DECIMATOR_MAX_FACTOR * DECIMATOR_TAPS_PER_PHASE)
+
+// Low-pass FIR decimator in polyphase form. The filter is split into
+// `factor` phases of DECIMATOR_TAPS_PER_PHASE taps, each applied to every
+// factor-th input sample, so only the kept outputs are computed. The inner
+// loop runs over consecutive outputs with one broadcast tap, which
+// vectorizes without horizontal sums.
+//
+// The filter is a Blackman windowed sinc cut off at the output Nyquist
+// frequency with a gain of one. Its transition band is wide, so only the
+// lower `passband` of the output spectrum is free of aliases (below -70 dB)
+// and flat; the rest is for the caller to discard.
+typedef struct {
+  unsigned int factor;
+  size_t taps;
+  float passband; // fraction of the output Nyquist frequency
+  float phases[DECIMATOR_MAX_FACTOR][DECIMATOR_TAPS_PER_PHASE];
+} Decimator;
+
+// Fails if factor is 0 or above DECIMATOR_MAX_FACTOR.
+bool decimatorInit(Decimator *d, const unsigned int factor);
+
+// Input samples that decimate needs for n outputs: (n - 1) * factor + taps.
+// The outputs are delayed by (taps - 1) / 2 input samples.
+size_t decimatorInputSize(const Decimator *d, const size_t n);
+
+// Writes n outputs, output m filtered from in[m * factor] onwards.
+void decimate(const Decimator *d, const float in[], float out[],
+              const size_t n);
+
+#endif // DECIMATOR_H
@@ -0,0 +1,58 @@
+#include "decimator.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define OUTPUTS 4096
+#define SKIP 64 // outputs at the start that are ignored
+
+static float input[(OUTPUTS - 1) * DECIMATOR_MAX_FACTOR + DECIMATOR_MAX_TAPS];
+static float output[OUTPUTS];
+
+// Gain of the decimator for a tone at `cycles` per input sample, from the
+// RMS of the output
+static double gain(const Decimator *d, const double cycles) {
+  const size_t n = decimatorInputSize(d, OUTPUTS);
+  for (size_t i = 0; i < n; ++i)
+    input[i] = sin(2.0 * M_PI * cycles * i);
+  decimate(d, input, output, OUTPUTS);
+  double sum = 0.0;
+  for (size_t m = SKIP; m < OUTPUTS; ++m)
+    sum += (double)output[m] * output[m];
+  return sqrt(2.0 * sum / (OUTPUTS - SKIP));
+}
+
+int main(void) {
+  int failed = 0;
+  const unsigned int factors[] = {2, 4, 8};
+  for (size_t f = 0; f < sizeof(factors) / sizeof(factors[0]); ++f) {
+    Decimator d;
+    if (!decimatorInit(&d, factors[f]))
+      return EXIT_FAILURE;
+    const double nyquist = 0.5 / d.factor; // of the output
+    const double edge = d.passband * nyquist;
+
+    // Flat up to the passband edge
+    double ripple = 0.0;
+    for (double c = edge / 64; c <= edge; c += edge / 64)
+      ripple = fmax(ripple, fabs(20.0 * log10(gain(&d, c))));
+
+    // Everything that folds into the passband is gone
+    double alias = -200.0;
+    for (double c = 2.0 * nyquist - edge; c <= 0.5; c += nyquist / 64) {
+      const double folded = fmod(c, 2.0 * nyquist);
+      if (folded < edge || 2.0 * nyquist - folded < edge)
+        alias = fmax(alias, 20.0 * log10(gain(&d, c)));
+    }
+
+    printf("/%u: %zu taps, passband %.3f, ripple %.3f dB, aliases %.1f dB\n",
+           d.factor, d.taps, d.passband, ripple, alias);
+    failed |= ripple > 0.1 || alias > -70.0;
+  }
+
+  Decimator d;
+  failed |= decimatorInit(&d, 0) || decimatorInit(&d, DECIMATOR_MAX_FACTOR + 1);
+
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
@@ -0,0 +1,103 @@
+#include "descriptors.h"
+#include "spectrum.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+// Common split of the audible range into seven bands
+static const float BAND_EDGES_HZ[DESCRIPTORS_BANDS + 1] = {
+    20.0f, 60.0f, 250.0f, 500.0f, 2000.0f, 4000.0f, 6000.0f, 20000.0f};
+
+static const char *BAND_NAMES[DESCRIPTORS_BANDS] = {
+    "SUB", "BASS", "LOW MID", "MID", "HIGH MID", "PRESENCE", "BRILLIANCE"};
+
+const char *descriptorsBandName(const int band) {
+  if (band < 0 || band >= DESCRIPTORS_BANDS)
+    return "?";
+  return BAND_NAMES[band];
+}
+
+bool descriptorsInit(DescriptorExtractor *fx, const size_t bins,
+                     const float binHz) {
+  descriptorsFree(fx);
+  fx->previous = malloc(bins * sizeof(float));
+  fx->cumulative = malloc(bins * sizeof(float));
+  if (fx->previous == NULL || fx->cumulative == NULL) {
+    descriptorsFree(fx);
+    return false;
+  }
+  fx->bins = bins;
+  fx->binHz = binHz;
+  for (int b = 0; b <= DESCRIPTORS_BANDS; ++b) {
+    const size_t k = ceilf(BAND_EDGES_HZ[b] / binHz);
+    fx->bandStart[b] = k < bins ? k : bins;
+  }
+  for (size_t k = 0; k < bins; ++k)
+    fx->previous[k] = -1.0f; // no previous spectrum yet
+  return true;
+}
+
+void descriptorsFree(DescriptorExtractor *fx) {
+  free(fx->previous);
+  free(fx->cumulative);
+  fx->previous = NULL;
+  fx->cumulative = NULL;
+  fx->bins = 0;
+}
+
+// First bin where the cumulative power reaches `target`
+static size_t rolloffBin(const float cumulative[], const size_t n,
+                         const float target) {
+  size_t lo = 0, hi = n - 1;
+  while (lo < hi) {
+    const size_t mid = (lo + hi) / 2;
+    if (cumulative[mid] < target)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+void descriptorsCompute(DescriptorExtractor *fx, const float magnitudes[],
+                     SpectralFeatures *out) {
+  *out = (SpectralFeatures){0};
+  const size_t n = fx->bins;
+  if (n < 2)
+    return;
+  const bool first = fx->previous[0] < 0.0f;
+
+  // Bin 0 (DC) is left out of every feature
+  float energy = 0.0f, weighted = 0.0f, logSum = 0.0f;
+  float magnitudeSum = 0.0f, rise = 0.0f;
+  int band = 0;
+  fx->cumulative[0] = 0.0f;
+  fx->previous[0] = magnitudes[0];
+  for (size_t k = 1; k < n; ++k) {
+    const float m = magnitudes[k];
+    const float p = m * m;
+    energy += p;
+    weighted += p * k;
+    logSum += fastLogf(p + DESCRIPTORS_POWER_FLOOR);
+    magnitudeSum += m;
+    const float d = m - fx->previous[k];
+    rise += d > 0.0f ? d : 0.0f;
+    fx->previous[k] = m;
+    fx->cumulative[k] = energy;
+
+    while (band < DESCRIPTORS_BANDS && k >= fx->bandStart[band + 1])
+      ++band;
+    if (band < DESCRIPTORS_BANDS && k >= fx->bandStart[band])
+      out->bandEnergies[band] += p;
+  }
+
+  out->energy = energy;
+  if (energy <= 0.0f)
+    return;
+  out->centroid = weighted / energy * fx->binHz;
+  out->rolloff =
+      rolloffBin(fx->cumulative, n, DESCRIPTORS_ROLLOFF * energy) * fx->binHz;
+  const float mean = energy / (n - 1) + DESCRIPTORS_POWER_FLOOR;
+  out->flatness = expf(logSum / (n - 1)) / mean;
+  out->flux = first || magnitudeSum <= 0.0f ? 0.0f : rise / magnitudeSum;
+}
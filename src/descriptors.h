@@ -0,0 +1,47 @@
+#ifndef DESCRIPTORS_H
+#define DESCRIPTORS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define DESCRIPTORS_BANDS 7
+#define DESCRIPTORS_ROLLOFF 0.85f      // fraction of the energy below the rolloff
+#define DESCRIPTORS_POWER_FLOOR 1e-10f // keeps silent bins out of the flatness
+
+// Spectral descriptors of one analysis hop, e.g. for driving lights
+typedef struct {
+  float centroid; // Hz, power-weighted mean frequency
+  float rolloff;  // Hz, DESCRIPTORS_ROLLOFF of the power lies below
+  float flatness; // 0 (tonal) to 1 (white noise), geometric / arithmetic mean
+  float flux;     // rise of the magnitudes since the previous hop, relative
+                  // to their sum
+  float energy;   // total power
+  float bandEnergies[DESCRIPTORS_BANDS]; // power from sub-bass to brilliance
+} SpectralFeatures;
+
+// Keeps the previous spectrum for the flux and the bins where the bands
+// start. Everything is computed in one pass over the magnitudes; only the
+// rolloff needs a binary search over the cumulative power written during it.
+typedef struct {
+  size_t bins;
+  float binHz;
+  size_t bandStart[DESCRIPTORS_BANDS + 1];
+  float *previous;   // bins entries
+  float *cumulative; // bins entries
+} DescriptorExtractor;
+
+// Prepares the extractor for spectra of `bins` magnitudes spaced binHz
+// apart. Frees the buffers of a previous init. Fails without memory.
+bool descriptorsInit(DescriptorExtractor *fx, const size_t bins,
+                     const float binHz);
+
+void descriptorsFree(DescriptorExtractor *fx);
+
+// Computes the features of the linear magnitudes. The first call after
+// descriptorsInit reports no flux.
+void descriptorsCompute(DescriptorExtractor *fx, const float magnitudes[],
+                     SpectralFeatures *out);
+
+const char *descriptorsBandName(const int band);
+
+#endif // DESCRIPTORS_H
@@ -0,0 +1,90 @@
+#include "descriptors.h"
+#include <math.h>
+#include <stdio.h>
+
+#define BINS 1024
+#define BIN_HZ (48000.0f / (2 * BINS))
+
+static DescriptorExtractor FX = {0};
+static float MAGNITUDES[BINS];
+
+static bool near(const char *what, const float measured, const float expected,
+                 const float tolerance) {
+  const bool ok = fabsf(measured - expected) <= tolerance;
+  printf("  %-10s %9.3f, expected %.3f%s\n", what, measured, expected,
+         ok ? "" : "  WRONG");
+  return ok;
+}
+
+static SpectralFeatures compute(void) {
+  SpectralFeatures features;
+  descriptorsCompute(&FX, MAGNITUDES, &features);
+  return features;
+}
+
+static void fill(const float magnitude) {
+  for (size_t k = 0; k < BINS; ++k)
+    MAGNITUDES[k] = magnitude;
+}
+
+int main(void) {
+  int failed = 0;
+  if (!descriptorsInit(&FX, BINS, BIN_HZ)) {
+    fprintf(stderr, "Could not allocate the descriptors\n");
+    return 1;
+  }
+
+  // A single tone in the bass is the centroid and the rolloff, tonal, and
+  // all of its power is in its band
+  printf("one bin at 100 Hz\n");
+  const size_t tone = lroundf(100.0f / BIN_HZ);
+  fill(0.0f);
+  MAGNITUDES[tone] = 2.0f;
+  SpectralFeatures f = compute();
+  failed |= !near("centroid", f.centroid, tone * BIN_HZ, 1e-3f);
+  failed |= !near("rolloff", f.rolloff, tone * BIN_HZ, 1e-3f);
+  failed |= !near("flatness", f.flatness, 0.0f, 1e-3f);
+  failed |= !near("energy", f.energy, 4.0f, 1e-6f);
+  failed |= !near("bass", f.bandEnergies[1], 4.0f, 1e-6f);
+  failed |= !near("flux", f.flux, 0.0f, 0.0f); // the first call
+
+  // Two equal tones: the centroid halfway, the rolloff at the upper one
+  printf("bins 100 and 300\n");
+  fill(0.0f);
+  MAGNITUDES[100] = MAGNITUDES[300] = 1.0f;
+  f = compute();
+  failed |= !near("centroid", f.centroid, 200 * BIN_HZ, 1e-2f);
+  failed |= !near("rolloff", f.rolloff, 300 * BIN_HZ, 1e-3f);
+
+  // White noise: flat, the centroid in the middle of the bins above DC and
+  // the rolloff where DESCRIPTORS_ROLLOFF of them lie below
+  printf("flat\n");
+  fill(1.0f);
+  f = compute();
+  failed |= !near("flatness", f.flatness, 1.0f, 1e-3f);
+  failed |= !near("centroid", f.centroid, BINS / 2 * BIN_HZ, 1e-1f);
+  failed |= !near("rolloff", f.rolloff,
+                  ceilf(DESCRIPTORS_ROLLOFF * (BINS - 1)) * BIN_HZ, BIN_HZ);
+
+  // The flux is the rise relative to the new magnitudes, falls do not count
+  printf("flux\n");
+  f = compute();
+  failed |= !near("same", f.flux, 0.0f, 0.0f);
+  fill(2.0f);
+  f = compute();
+  failed |= !near("doubled", f.flux, 0.5f, 1e-6f);
+  fill(1.0f);
+  f = compute();
+  failed |= !near("halved", f.flux, 0.0f, 0.0f);
+
+  // Silence has no features at all
+  printf("silence\n");
+  fill(0.0f);
+  f = compute();
+  failed |= !near("energy", f.energy, 0.0f, 0.0f);
+  failed |= !near("centroid", f.centroid, 0.0f, 0.0f);
+
+  descriptorsFree(&FX);
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
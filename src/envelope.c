@@ -0,0 +1,36 @@
+#include "envelope.h"
+#include "simd.h"
+#include <math.h>
+
+static inline float coefficient(const float seconds, const float dt) {
+  return seconds > 0.0f ? 1.0f - expf(-dt / seconds) : 1.0f;
+}
+
+Envelope envelopeCoefficients(const float attackSeconds,
+                              const float releaseSeconds, const float dt) {
+  return (Envelope){
+      .attack = coefficient(attackSeconds, dt),
+      .release = coefficient(releaseSeconds, dt),
+  };
+}
+
+void envelopeApply(float y[], const float x[], const size_t n,
+                   const Envelope envelope) {
+  size_t i = 0;
+
+#ifdef VF_WIDTH
+  const vf attack = vfSet(envelope.attack);
+  const vf release = vfSet(envelope.release);
+  for (; i + VF_WIDTH <= n; i += VF_WIDTH) {
+    const vf yi = vfLoad(&y[i]);
+    const vf xi = vfLoad(&x[i]);
+    const vf c = vfSelectGreater(xi, yi, attack, release);
+    vfStore(&y[i], vfAdd(yi, vfMul(vfSub(xi, yi), c)));
+  }
+#endif // VF_WIDTH
+
+  for (; i < n; ++i) {
+    const float c = x[i] > y[i] ? envelope.attack : envelope.release;
+    y[i] += (x[i] - y[i]) * c;
+  }
+}
@@ -0,0 +1,24 @@
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+#include <stddef.h>
+
+// One-pole attack/release envelope follower. Every step moves y towards x by
+// y += (x - y) * c, with c = 1 - exp(-dt / tau) and tau the attack time if
+// x > y, else the release time. This is the exact solution of the continuous
+// filter over dt, so it never overshoots and N steps of dt / N give the same
+// response as one step of dt, unlike the Euler step y += (x - y) * dt / tau.
+typedef struct {
+  float attack;
+  float release;
+} Envelope;
+
+// Coefficients for a step of `dt` seconds. A time of zero follows x at once.
+Envelope envelopeCoefficients(const float attackSeconds,
+                              const float releaseSeconds, const float dt);
+
+// Advances the n envelopes y towards their targets x by one step.
+void envelopeApply(float y[], const float x[], const size_t n,
+                   const Envelope envelope);
+
+#endif // ENVELOPE_H
@@ -0,0 +1,77 @@
+#include "envelope.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define N 37 // a few vectors and a scalar tail
+#define ATTACK_SECONDS 0.05f
+#define RELEASE_SECONDS 0.3f
+#define SHARED_SECONDS (1.0 / 6.0) // a whole number of frames at every rate
+
+static const int FPS[] = {30, 60, 144};
+#define RATES (sizeof(FPS) / sizeof(FPS[0]))
+#define SHARED 12 // shared times after the start, 2 s
+
+// Rises at 1/6 s and falls at 5/6 s, to a different level per envelope
+static float target(const size_t i, const double time) {
+  const bool up = time >= SHARED_SECONDS && time < 5 * SHARED_SECONDS;
+  return up ? 1.0f + 0.1f * i : -0.5f * i / N;
+}
+
+// The exact response at `time` of the envelope i
+static float exact(const size_t i, const double time) {
+  const float low = target(i, 0.0), high = target(i, SHARED_SECONDS);
+  if (time <= SHARED_SECONDS)
+    return low;
+  const float rise = expf(-(fminf(time, 5 * SHARED_SECONDS) - SHARED_SECONDS) /
+                          ATTACK_SECONDS);
+  const float peak = high + (low - high) * rise;
+  if (time <= 5 * SHARED_SECONDS)
+    return peak;
+  return low + (peak - low) * expf(-(time - 5 * SHARED_SECONDS) /
+                                   RELEASE_SECONDS);
+}
+
+int main(void) {
+  static float at[RATES][SHARED + 1][N];
+  for (size_t r = 0; r < RATES; ++r) {
+    const float dt = 1.0f / FPS[r];
+    const Envelope envelope =
+        envelopeCoefficients(ATTACK_SECONDS, RELEASE_SECONDS, dt);
+    const int framesPerShared = FPS[r] * SHARED_SECONDS + 0.5;
+    float y[N], x[N];
+    for (size_t i = 0; i < N; ++i)
+      y[i] = target(i, 0.0);
+    for (int frame = 0; frame <= SHARED * framesPerShared; ++frame) {
+      if (frame % framesPerShared == 0)
+        for (size_t i = 0; i < N; ++i)
+          at[r][frame / framesPerShared][i] = y[i];
+      // The target a frame draws, held until the next one
+      for (size_t i = 0; i < N; ++i)
+        x[i] = target(i, (double)frame / FPS[r]);
+      envelopeApply(y, x, N, envelope);
+    }
+  }
+
+  // Against each other and against the continuous filter
+  float worstRates = 0.0f, worstExact = 0.0f;
+  for (int s = 0; s <= SHARED; ++s)
+    for (size_t i = 0; i < N; ++i) {
+      for (size_t r = 1; r < RATES; ++r)
+        worstRates = fmaxf(worstRates, fabsf(at[r][s][i] - at[0][s][i]));
+      worstExact = fmaxf(worstExact,
+                         fabsf(at[0][s][i] - exact(i, s * SHARED_SECONDS)));
+    }
+  printf("30/60/144 FPS differ by at most %g, from the exact response by "
+         "%g\n",
+         worstRates, worstExact);
+
+  // A zero time follows at once
+  float y = 0.0f;
+  const float x = 1.0f;
+  envelopeApply(&y, &x, 1, envelopeCoefficients(0.0f, 0.0f, 0.01f));
+
+  const int failed = worstRates > 1e-4f || worstExact > 1e-4f || y != 1.0f;
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
@@ -0,0 +1,155 @@
+#include "filterbank.h"
+#include "spectrum.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static float hzToScale(const FilterbankScale scale, const float hz) {
+  switch (scale) {
+  case FILTERBANK_MEL:
+    return 2595.0f * log10f(1.0f + hz / 700.0f);
+  case FILTERBANK_ERB:
+    return 21.4f * log10f(1.0f + 0.00437f * hz);
+  }
+  assert(false && "Unknown filterbank scale");
+  return 0.0f;
+}
+
+static float scaleToHz(const FilterbankScale scale, const float x) {
+  switch (scale) {
+  case FILTERBANK_MEL:
+    return 700.0f * (powf(10.0f, x / 2595.0f) - 1.0f);
+  case FILTERBANK_ERB:
+    return (powf(10.0f, x / 21.4f) - 1.0f) / 0.00437f;
+  }
+  assert(false && "Unknown filterbank scale");
+  return 0.0f;
+}
+
+const char *filterbankScaleName(const FilterbankScale scale) {
+  switch (scale) {
+  case FILTERBANK_MEL:
+    return "MEL";
+  case FILTERBANK_ERB:
+    return "ERB";
+  }
+  return "UNKNOWN";
+}
+
+void filterbankFree(Filterbank *fb) {
+  free(fb->rowOffsets);
+  free(fb->firstColumns);
+  free(fb->weights);
+  fb->rowOffsets = NULL;
+  fb->firstColumns = NULL;
+  fb->weights = NULL;
+  fb->config.bands = 0;
+  fb->bins = 0;
+}
+
+// Bin range [first, last] covered by the triangle lo < center < hi, with at
+// least one bin so that narrow low-frequency bands are never empty.
+static void triangleColumns(const float lo, const float center, const float hi,
+                            const size_t bins, const float binHz,
+                            size_t *first, size_t *last) {
+  long f = (long)ceilf(lo / binHz);
+  long l = (long)floorf(hi / binHz);
+  if (f < 0)
+    f = 0;
+  if (l > (long)bins - 1)
+    l = (long)bins - 1;
+  if (l < f) {
+    f = l = (long)roundf(center / binHz);
+    if (f > (long)bins - 1)
+      f = l = (long)bins - 1;
+  }
+  *first = f;
+  *last = l;
+}
+
+static float triangle(const float lo, const float center, const float hi,
+                      const float hz) {
+  if (hz <= lo || hz >= hi)
+    return 0.0f;
+  return hz < center ? (hz - lo) / (center - lo) : (hi - hz) / (hi - center);
+}
+
+bool filterbankInit(Filterbank *fb, const FilterbankConfig config,
+                    const size_t bins, const float binHz) {
+  filterbankFree(fb);
+  assert(config.bands > 0 && bins > 0 && binHz > 0.0f);
+  assert(config.minHz < config.maxHz);
+
+  const size_t bands = config.bands;
+  const float nyquistHz = bins * binHz;
+  const float lo = hzToScale(config.scale, config.minHz);
+  const float hi = hzToScale(config.scale, fminf(config.maxHz, nyquistHz));
+
+  // bands + 2 equally spaced points on the scale: edges and centers
+  float *edges = malloc(sizeof(float) * (bands + 2));
+  fb->rowOffsets = malloc(sizeof(size_t) * (bands + 1));
+  fb->firstColumns = malloc(sizeof(size_t) * bands);
+  if (edges == NULL || fb->rowOffsets == NULL || fb->firstColumns == NULL) {
+    fprintf(stderr, "Could not allocate filterbank with %zu bands\n", bands);
+    free(edges);
+    filterbankFree(fb);
+    return false;
+  }
+  for (size_t i = 0; i < bands + 2; ++i)
+    edges[i] = scaleToHz(config.scale, lo + (hi - lo) * i / (bands + 1));
+
+  // First pass: row lengths, to allocate the weights in one block
+  fb->rowOffsets[0] = 0;
+  for (size_t b = 0; b < bands; ++b) {
+    size_t first, last;
+    triangleColumns(edges[b], edges[b + 1], edges[b + 2], bins, binHz, &first,
+                    &last);
+    fb->firstColumns[b] = first;
+    fb->rowOffsets[b + 1] = fb->rowOffsets[b] + (last - first + 1);
+  }
+
+  fb->weights = malloc(sizeof(float) * fb->rowOffsets[bands]);
+  if (fb->weights == NULL) {
+    fprintf(stderr, "Could not allocate filterbank with %zu weights\n",
+            fb->rowOffsets[bands]);
+    free(edges);
+    filterbankFree(fb);
+    return false;
+  }
+
+  // Second pass: the normalized triangle weights
+  for (size_t b = 0; b < bands; ++b) {
+    float *row = &fb->weights[fb->rowOffsets[b]];
+    const size_t n = fb->rowOffsets[b + 1] - fb->rowOffsets[b];
+    float sum = 0.0f;
+    for (size_t j = 0; j < n; ++j) {
+      row[j] = triangle(edges[b], edges[b + 1], edges[b + 2],
+                        (fb->firstColumns[b] + j) * binHz);
+      sum += row[j];
+    }
+    if (sum <= 0.0f) { // Band narrower than a bin: take the nearest one
+      for (size_t j = 0; j < n; ++j)
+        row[j] = 1.0f / n;
+    } else {
+      for (size_t j = 0; j < n; ++j)
+        row[j] /= sum;
+    }
+  }
+
+  free(edges);
+  fb->config = config;
+  fb->bins = bins;
+  fb->binHz = binHz;
+  return true;
+}
+
+void filterbankApply(const Filterbank *fb, const float spectrum[],
+                     float bands[]) {
+  for (size_t b = 0; b < fb->config.bands; ++b) {
+    const size_t offset = fb->rowOffsets[b];
+    bands[b] = spectrumDot(&fb->weights[offset],
+                           &spectrum[fb->firstColumns[b]],
+                           fb->rowOffsets[b + 1] - offset);
+  }
+}
@@ -0,0 +1,49 @@
+#ifndef FILTERBANK_H
+#define FILTERBANK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+  FILTERBANK_MEL, // mel(f) = 2595 * log10(1 + f / 700)
+  FILTERBANK_ERB, // ERB-rate(f) = 21.4 * log10(1 + 0.00437 * f)
+} FilterbankScale;
+
+typedef struct {
+  FilterbankScale scale;
+  size_t bands;
+  float minHz;
+  float maxHz;
+} FilterbankConfig;
+
+// Triangular filters on the mel or ERB scale, stored as a sparse matrix in
+// CSR form with one row per band. The nonzeros of a triangular filter are
+// contiguous bins, so instead of a column index per weight each row only
+// stores its first column. Applying a row is then a dense dot product over
+// `weights[rowOffsets[b] .. rowOffsets[b + 1]]`, which vectorizes without
+// gathers. Every row is normalized to sum to one, so a band is the weighted
+// mean of the magnitudes under its filter.
+typedef struct {
+  FilterbankConfig config;
+  size_t bins;
+  float binHz;
+  size_t *rowOffsets;   // bands + 1 entries
+  size_t *firstColumns; // bands entries
+  float *weights;       // rowOffsets[bands] entries
+} Filterbank;
+
+// Builds the filter matrix for a spectrum of `bins` bins that are `binHz`
+// apart (sample rate / FFT size). maxHz is limited to the highest bin, but
+// the requested config is kept. Frees a previously built matrix.
+bool filterbankInit(Filterbank *fb, const FilterbankConfig config,
+                    const size_t bins, const float binHz);
+
+void filterbankFree(Filterbank *fb);
+
+// bands[b] = sum_k W[b][k] * spectrum[k] for all config.bands rows.
+void filterbankApply(const Filterbank *fb, const float spectrum[],
+                     float bands[]);
+
+const char *filterbankScaleName(const FilterbankScale scale);
+
+#endif // FILTERBANK_H
@@ -0,0 +1,129 @@
+#include "filterbank.h"
+#include <math.h>
+#include <stdio.h>
+
+#define SAMPLE_RATE 48000.0
+#define FFT_SIZE 4096
+#define BINS (FFT_SIZE / 2)
+#define BIN_HZ (SAMPLE_RATE / FFT_SIZE)
+#define MAX_BANDS 128
+
+static float SPECTRUM[BINS];
+static float BANDS[MAX_BANDS];
+
+// The scales of filterbank.h, in double to check the float ones against
+static double toScale(const FilterbankScale scale, const double hz) {
+  return scale == FILTERBANK_MEL ? 2595.0 * log10(1.0 + hz / 700.0)
+                                 : 21.4 * log10(1.0 + 0.00437 * hz);
+}
+
+static double toHz(const FilterbankScale scale, const double x) {
+  return scale == FILTERBANK_MEL ? 700.0 * (pow(10.0, x / 2595.0) - 1.0)
+                                 : (pow(10.0, x / 21.4) - 1.0) / 0.00437;
+}
+
+// Edge i of bands + 2 equally spaced points on the scale
+static double edge(const FilterbankConfig config, const size_t i) {
+  const double lo = toScale(config.scale, config.minHz);
+  const double hi =
+      toScale(config.scale, fmin(config.maxHz, BINS * BIN_HZ));
+  return toHz(config.scale, lo + (hi - lo) * i / (config.bands + 1));
+}
+
+// Every row covers exactly the bins inside its triangle, at least one, sums
+// to one and peaks at its center; the rows follow each other up the
+// spectrum. A flat spectrum stays flat.
+static bool rows(const char *name, const FilterbankConfig config) {
+  Filterbank fb = {0};
+  if (!filterbankInit(&fb, config, BINS, BIN_HZ)) {
+    printf("%-24s could not be built\n", name);
+    return false;
+  }
+  unsigned long wrong = 0;
+  float worstSum = 0.0f;
+  for (size_t b = 0; b < config.bands; ++b) {
+    const double lo = edge(config, b), center = edge(config, b + 1),
+                 hi = edge(config, b + 2);
+    const size_t first = fb.firstColumns[b];
+    const size_t n = fb.rowOffsets[b + 1] - fb.rowOffsets[b];
+    const float *row = &fb.weights[fb.rowOffsets[b]];
+    float sum = 0.0f, peak = 0.0f;
+    size_t peakBin = first;
+    for (size_t j = 0; j < n; ++j) {
+      sum += row[j];
+      if (row[j] > peak) {
+        peak = row[j];
+        peakBin = first + j;
+      }
+    }
+    worstSum = fmaxf(worstSum, fabsf(sum - 1.0f));
+
+    if (n == 0 || (b > 0 && first < fb.firstColumns[b - 1]))
+      ++wrong;
+    if (hi - lo < 2.0 * BIN_HZ)
+      continue; // Narrower than the bins, the nearest one stands in
+    for (size_t k = 0; k < BINS; ++k) {
+      const double hz = k * BIN_HZ;
+      const bool inside = hz > lo + 1e-2 && hz < hi - 1e-2;
+      const bool inRow = k >= first && k < first + n && row[k - first] > 0.0f;
+      if (inside != inRow && fabs(hz - lo) > 1e-2 && fabs(hz - hi) > 1e-2)
+        ++wrong;
+    }
+    if (fabs(peakBin * BIN_HZ - center) > BIN_HZ)
+      ++wrong;
+  }
+
+  for (size_t k = 0; k < BINS; ++k)
+    SPECTRUM[k] = 1.0f;
+  filterbankApply(&fb, SPECTRUM, BANDS);
+  float worstFlat = 0.0f;
+  for (size_t b = 0; b < config.bands; ++b)
+    worstFlat = fmaxf(worstFlat, fabsf(BANDS[b] - 1.0f));
+
+  printf("%-24s %lu wrong rows, sums off by %g, flat off by %g\n", name,
+         wrong, worstSum, worstFlat);
+  filterbankFree(&fb);
+  return wrong == 0 && worstSum < 1e-5f && worstFlat < 1e-5f;
+}
+
+// A single band whose center is `hz` peaks at one of the two bins around
+// `hz`, which pins the constants of the scale
+static bool anchor(const char *name, const FilterbankScale scale,
+                   const double hz) {
+  const FilterbankConfig config = {
+      .scale = scale,
+      .bands = 1,
+      .minHz = 0.0f,
+      .maxHz = toHz(scale, 2.0 * toScale(scale, hz)),
+  };
+  Filterbank fb = {0};
+  if (!filterbankInit(&fb, config, BINS, BIN_HZ))
+    return false;
+  size_t peakBin = 0;
+  for (size_t j = 1; j < fb.rowOffsets[1]; ++j)
+    if (fb.weights[j] > fb.weights[peakBin])
+      peakBin = j;
+  const double peakHz = (fb.firstColumns[0] + peakBin) * BIN_HZ;
+  printf("%-24s centered at %.1f Hz, expected %.1f\n", name, peakHz, hz);
+  filterbankFree(&fb);
+  return fabs(peakHz - hz) < BIN_HZ;
+}
+
+int main(void) {
+  int failed = 0;
+  failed |= !anchor("mel 1000 Hz", FILTERBANK_MEL, 1000.0);
+  failed |= !anchor("ERB 1000 Hz", FILTERBANK_ERB, 1000.0);
+
+  failed |= !rows("mel 40 bands", (FilterbankConfig){FILTERBANK_MEL, 40,
+                                                     20.0f, 20000.0f});
+  failed |= !rows("ERB 64 bands", (FilterbankConfig){FILTERBANK_ERB, 64,
+                                                     20.0f, 20000.0f});
+  // More bands than bins at the bottom, and maxHz above Nyquist
+  failed |= !rows("mel 128 bands to 30 kHz",
+                  (FilterbankConfig){FILTERBANK_MEL, 128, 0.0f, 30000.0f});
+  failed |= !rows("ERB 128 bands to 30 kHz",
+                  (FilterbankConfig){FILTERBANK_ERB, 128, 0.0f, 30000.0f});
+
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
@@ -0,0 +1,286 @@
+#include "loudness.h"
+#include <math.h>
+
+#define LOUDNESS_OFFSET -0.691 // BS.1770: L = -0.691 + 10 log10(sum G_i z_i)
+#define LOUDNESS_SILENCE 1.0e-10 // mean square floor, about -100 LUFS
+
+// K-weighting stage 1, a high shelf (BS.1770 pre-filter), for any sample
+// rate. Design parameters as in libebur128.
+static Biquad shelfFilter(const double sampleRate) {
+  const double f0 = 1681.974450955533;
+  const double gain = 3.999843853973347;
+  const double q = 0.7071752369554196;
+  const double k = tan(M_PI * f0 / sampleRate);
+  const double vh = pow(10.0, gain / 20.0);
+  const double vb = pow(vh, 0.4996667741545416);
+  const double a0 = 1.0 + k / q + k * k;
+  return (Biquad){
+      .b0 = (vh + vb * k / q + k * k) / a0,
+      .b1 = 2.0 * (k * k - vh) / a0,
+      .b2 = (vh - vb * k / q + k * k) / a0,
+      .a1 = 2.0 * (k * k - 1.0) / a0,
+      .a2 = (1.0 - k / q + k * k) / a0,
+  };
+}
+
+// K-weighting stage 2, the RLB high-pass
+static Biquad highPassFilter(const double sampleRate) {
+  const double f0 = 38.13547087602444;
+  const double q = 0.5003270373238773;
+  const double k = tan(M_PI * f0 / sampleRate);
+  const double a0 = 1.0 + k / q + k * k;
+  return (Biquad){
+      .b0 = 1.0,
+      .b1 = -2.0,
+      .b2 = 1.0,
+      .a1 = 2.0 * (k * k - 1.0) / a0,
+      .a2 = (1.0 - k / q + k * k) / a0,
+  };
+}
+
+static inline double biquad(const Biquad *f, BiquadState *s, const double x) {
+  const double y = f->b0 * x + s->z1;
+  s->z1 = f->b1 * x - f->a1 * y + s->z2;
+  s->z2 = f->b2 * x - f->a2 * y;
+  return y;
+}
+
+static inline double toLufs(const double meanSquare) {
+  return LOUDNESS_OFFSET +
+         10.0 * log10(meanSquare > LOUDNESS_SILENCE ? meanSquare
+                                                    : LOUDNESS_SILENCE);
+}
+
+static inline double fromLufs(const double lufs) {
+  return pow(10.0, (lufs - LOUDNESS_OFFSET) / 10.0);
+}
+
+static inline double histogramLufs(const size_t bin) {
+  return LOUDNESS_ABSOLUTE_GATE + (bin + 0.5) * LOUDNESS_HISTOGRAM_STEP;
+}
+
+// Lowpass at the original Nyquist frequency for the oversampled rate,
+// Hann-windowed sinc split into TRUE_PEAK_OVERSAMPLING phases. Centered on
+// a tap, so that phase 0 passes the samples through and the others fall
+// exactly between them (the window's zero last tap is left out).
+static void designPolyphase(LoudnessMeter *meter) {
+  const int taps = TRUE_PEAK_OVERSAMPLING * TRUE_PEAK_TAPS_PER_PHASE;
+  const double center = taps / 2.0;
+  for (int n = 0; n < taps; ++n) {
+    const double x = (n - center) / TRUE_PEAK_OVERSAMPLING;
+    const double sinc = x == 0.0 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+    const double window = 0.5 * (1.0 + cos(2.0 * M_PI * (n - center) / taps));
+    // Tap k of phase p multiplies the sample k steps in the past
+    meter->polyphase[n % TRUE_PEAK_OVERSAMPLING]
+                    [TRUE_PEAK_TAPS_PER_PHASE - 1 - n / TRUE_PEAK_OVERSAMPLING] =
+        sinc * window;
+  }
+}
+
+void loudnessInit(LoudnessMeter *meter, const unsigned int sampleRate,
+                  const unsigned int channels) {
+  meter->sampleRate = sampleRate;
+  meter->stride = channels;
+  meter->channels =
+      channels < LOUDNESS_MAX_CHANNELS ? channels : LOUDNESS_MAX_CHANNELS;
+
+  // BS.1770 weights for the 5.1 layout L R C LFE Ls Rs, 1 otherwise
+  for (unsigned int c = 0; c < LOUDNESS_MAX_CHANNELS; ++c) {
+    meter->weights[c] = 1.0f;
+    if (channels >= 6 && c == 3)
+      meter->weights[c] = 0.0f;
+    else if (channels >= 6 && (c == 4 || c == 5))
+      meter->weights[c] = 1.41f;
+  }
+
+  meter->shelf = shelfFilter(sampleRate);
+  meter->highPass = highPassFilter(sampleRate);
+  for (unsigned int c = 0; c < LOUDNESS_MAX_CHANNELS; ++c) {
+    meter->shelfState[c] = (BiquadState){0};
+    meter->highPassState[c] = (BiquadState){0};
+    for (size_t k = 0; k < 2 * TRUE_PEAK_TAPS_PER_PHASE; ++k)
+      meter->history[c][k] = 0.0f;
+  }
+
+  meter->subBlockFrames = lround(sampleRate * LOUDNESS_SUBBLOCK_SECONDS);
+  meter->subBlockFill = 0;
+  meter->subBlockSum = 0.0;
+  meter->subBlockHead = 0;
+  meter->subBlockCount = 0;
+  for (size_t i = 0; i < LOUDNESS_HISTOGRAM_BINS; ++i) {
+    meter->histogram[i] = 0;
+    meter->rangeHistogram[i] = 0;
+  }
+
+  designPolyphase(meter);
+  meter->historyHead = 0;
+  meter->truePeak = 0.0f;
+
+  atomic_store_explicit(&meter->momentary, toLufs(0.0), memory_order_relaxed);
+  atomic_store_explicit(&meter->shortTerm, toLufs(0.0), memory_order_relaxed);
+  atomic_store_explicit(&meter->integrated, toLufs(0.0), memory_order_relaxed);
+  atomic_store_explicit(&meter->truePeakDb, 10.0 * log10(LOUDNESS_SILENCE),
+                        memory_order_relaxed);
+  atomic_store_explicit(&meter->range, 0.0f, memory_order_relaxed);
+}
+
+// Mean square of the newest n sub-blocks
+static double meanSubBlocks(const LoudnessMeter *meter, const size_t n) {
+  double sum = 0.0;
+  for (size_t age = 0; age < n; ++age)
+    sum += meter->subBlocks[(meter->subBlockHead + LOUDNESS_SHORT_TERM_SUBBLOCKS -
+                             1 - age) %
+                            LOUDNESS_SHORT_TERM_SUBBLOCKS];
+  return sum / n;
+}
+
+// Mean loudness of the histogram bins above `gate`, and how many blocks
+// they hold
+static double histogramMean(const unsigned long histogram[],
+                            const double gate, unsigned long *count) {
+  double energy = 0.0;
+  *count = 0;
+  for (size_t i = 0; i < LOUDNESS_HISTOGRAM_BINS; ++i) {
+    if (histogramLufs(i) <= gate)
+      continue;
+    energy += histogram[i] * fromLufs(histogramLufs(i));
+    *count += histogram[i];
+  }
+  return *count > 0 ? toLufs(energy / *count) : toLufs(0.0);
+}
+
+// Gated mean over the histogram: first the absolute gate (the histogram
+// starts there), then the relative gate below the absolute-gated loudness.
+static double integratedLoudness(const LoudnessMeter *meter) {
+  unsigned long count;
+  const double ungated =
+      histogramMean(meter->histogram, LOUDNESS_ABSOLUTE_GATE, &count);
+  if (count == 0)
+    return toLufs(0.0);
+  return histogramMean(meter->histogram, ungated + LOUDNESS_RELATIVE_GATE,
+                       &count);
+}
+
+static void addToHistogram(unsigned long histogram[], const double lufs) {
+  long bin = (lufs - LOUDNESS_ABSOLUTE_GATE) / LOUDNESS_HISTOGRAM_STEP;
+  if (bin >= LOUDNESS_HISTOGRAM_BINS)
+    bin = LOUDNESS_HISTOGRAM_BINS - 1;
+  ++histogram[bin];
+}
+
+// EBU Tech 3342: the short-term values above the relative gate, 20 LU below
+// their mean, from the 10th to the 95th percentile
+static double loudnessRange(const LoudnessMeter *meter) {
+  const unsigned long *histogram = meter->rangeHistogram;
+  unsigned long count;
+  const double gate =
+      histogramMean(histogram, LOUDNESS_ABSOLUTE_GATE, &count) +
+      LOUDNESS_RANGE_GATE;
+  histogramMean(histogram, gate, &count);
+  if (count == 0)
+    return 0.0;
+
+  double low = 0.0, high = 0.0;
+  unsigned long below = 0;
+  for (size_t i = 0; i < LOUDNESS_HISTOGRAM_BINS; ++i) {
+    if (histogramLufs(i) <= gate)
+      continue;
+    if (below <= LOUDNESS_RANGE_LOW * count)
+      low = histogramLufs(i);
+    below += histogram[i];
+    high = histogramLufs(i);
+    if (below >= LOUDNESS_RANGE_HIGH * count)
+      break;
+  }
+  return high - low;
+}
+
+static void finishSubBlock(LoudnessMeter *meter) {
+  meter->subBlocks[meter->subBlockHead] =
+      meter->subBlockSum / meter->subBlockFrames;
+  meter->subBlockHead =
+      (meter->subBlockHead + 1) % LOUDNESS_SHORT_TERM_SUBBLOCKS;
+  if (meter->subBlockCount < LOUDNESS_SHORT_TERM_SUBBLOCKS)
+    ++meter->subBlockCount;
+  meter->subBlockSum = 0.0;
+  meter->subBlockFill = 0;
+
+  if (meter->subBlockCount >= LOUDNESS_MOMENTARY_SUBBLOCKS) {
+    // The momentary window is also the 400 ms gating block, 75 % overlap
+    const double momentary =
+        toLufs(meanSubBlocks(meter, LOUDNESS_MOMENTARY_SUBBLOCKS));
+    atomic_store_explicit(&meter->momentary, momentary, memory_order_relaxed);
+
+    if (momentary > LOUDNESS_ABSOLUTE_GATE) {
+      addToHistogram(meter->histogram, momentary);
+      atomic_store_explicit(&meter->integrated, integratedLoudness(meter),
+                            memory_order_relaxed);
+    }
+  }
+  if (meter->subBlockCount >= LOUDNESS_SHORT_TERM_SUBBLOCKS) {
+    // Sampled every 100 ms, as Tech 3342 asks for at least 10 Hz
+    const double shortTerm =
+        toLufs(meanSubBlocks(meter, LOUDNESS_SHORT_TERM_SUBBLOCKS));
+    atomic_store_explicit(&meter->shortTerm, shortTerm, memory_order_relaxed);
+
+    if (shortTerm > LOUDNESS_ABSOLUTE_GATE) {
+      addToHistogram(meter->rangeHistogram, shortTerm);
+      atomic_store_explicit(&meter->range, loudnessRange(meter),
+                            memory_order_relaxed);
+    }
+  }
+}
+
+static float oversampledPeak(const LoudnessMeter *meter, const float *newest) {
+  float peak = 0.0f;
+  for (int p = 0; p < TRUE_PEAK_OVERSAMPLING; ++p) {
+    float y = 0.0f;
+    for (int k = 0; k < TRUE_PEAK_TAPS_PER_PHASE; ++k)
+      y += meter->polyphase[p][k] * newest[k];
+    y = fabsf(y);
+    peak = y > peak ? y : peak;
+  }
+  return peak;
+}
+
+void loudnessProcess(LoudnessMeter *meter, const float samples[],
+                     const unsigned int frames) {
+  if (meter->subBlockFrames == 0)
+    return; // Not initialized
+
+  const float peakBefore = meter->truePeak;
+  for (unsigned int f = 0; f < frames; ++f) {
+    const float *frame = &samples[f * meter->stride];
+    const size_t head = meter->historyHead;
+    for (unsigned int c = 0; c < meter->channels; ++c) {
+      const double k = biquad(&meter->highPass, &meter->highPassState[c],
+                              biquad(&meter->shelf, &meter->shelfState[c],
+                                     frame[c]));
+      meter->subBlockSum += meter->weights[c] * k * k;
+
+      float *history = meter->history[c];
+      history[head] = frame[c];
+      history[head + TRUE_PEAK_TAPS_PER_PHASE] = frame[c];
+      const float peak = oversampledPeak(meter, &history[head + 1]);
+      meter->truePeak = peak > meter->truePeak ? peak : meter->truePeak;
+    }
+    meter->historyHead = (head + 1) % TRUE_PEAK_TAPS_PER_PHASE;
+
+    if (++meter->subBlockFill == meter->subBlockFrames)
+      finishSubBlock(meter);
+  }
+  if (meter->truePeak > peakBefore)
+    atomic_store_explicit(&meter->truePeakDb, 20.0f * log10f(meter->truePeak),
+                          memory_order_relaxed);
+}
+
+LoudnessReadout loudnessRead(const LoudnessMeter *meter) {
+  return (LoudnessReadout){
+      .momentary = atomic_load_explicit(&meter->momentary, memory_order_relaxed),
+      .shortTerm = atomic_load_explicit(&meter->shortTerm, memory_order_relaxed),
+      .integrated =
+          atomic_load_explicit(&meter->integrated, memory_order_relaxed),
+      .truePeak = atomic_load_explicit(&meter->truePeakDb, memory_order_relaxed),
+      .range = atomic_load_explicit(&meter->range, memory_order_relaxed),
+  };
+}
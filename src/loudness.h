@@ -0,0 +1,97 @@
+#ifndef LOUDNESS_H
+#define LOUDNESS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define LOUDNESS_MAX_CHANNELS 8
+#define LOUDNESS_SUBBLOCK_SECONDS 0.1
+#define LOUDNESS_MOMENTARY_SUBBLOCKS 4   // 400 ms
+#define LOUDNESS_SHORT_TERM_SUBBLOCKS 30 // 3 s
+#define LOUDNESS_ABSOLUTE_GATE -70.0     // LUFS
+#define LOUDNESS_RELATIVE_GATE -10.0     // LU
+#define LOUDNESS_HISTOGRAM_STEP 0.1      // LU
+#define LOUDNESS_HISTOGRAM_MAX 5.0       // LUFS
+#define LOUDNESS_HISTOGRAM_BINS 750      // from the absolute gate to max
+#define LOUDNESS_RANGE_GATE -20.0        // LU
+#define LOUDNESS_RANGE_LOW 0.10          // percentiles of the gated
+#define LOUDNESS_RANGE_HIGH 0.95         // short-term distribution
+#define TRUE_PEAK_OVERSAMPLING 4
+#define TRUE_PEAK_TAPS_PER_PHASE 12
+
+typedef struct {
+  double b0, b1, b2, a1, a2;
+} Biquad;
+
+typedef struct {
+  double z1, z2; // transposed direct form II
+} BiquadState;
+
+typedef struct {
+  float momentary;  // LUFS, 400 ms
+  float shortTerm;  // LUFS, 3 s
+  float integrated; // LUFS, gated since the reset
+  float truePeak;   // dBTP, maximum since the reset
+  float range;      // LU, loudness range (EBU Tech 3342) since the reset
+} LoudnessReadout;
+
+// EBU R128 / ITU-R BS.1770 loudness and true-peak meter.
+//
+// It is fed the interleaved float blocks of the audio callback and keeps
+// only running sums: K-weighting biquads, the mean square of the current
+// 100 ms sub-block and a ring of the last 30 sub-blocks. Every 100 ms the
+// momentary (last 4 sub-blocks) and short-term (last 30) loudness are
+// updated. Gated 400 ms blocks go into a histogram with 0.1 LU bins, from
+// which the integrated loudness is computed without looking at the history
+// again, and so do the short-term values for the loudness range. True peak
+// is the maximum of a 4x oversampled polyphase interpolation. Nothing is
+// allocated after loudnessInit.
+//
+// loudnessProcess runs on one thread, the audio thread or a worker that it
+// hands the frames to, loudnessRead may run on any other thread.
+typedef struct {
+  unsigned int sampleRate;
+  unsigned int stride;   // interleaved channels of the stream
+  unsigned int channels; // metered channels
+  float weights[LOUDNESS_MAX_CHANNELS];
+
+  Biquad shelf;
+  Biquad highPass;
+  BiquadState shelfState[LOUDNESS_MAX_CHANNELS];
+  BiquadState highPassState[LOUDNESS_MAX_CHANNELS];
+
+  unsigned int subBlockFrames;
+  unsigned int subBlockFill;
+  double subBlockSum;
+  double subBlocks[LOUDNESS_SHORT_TERM_SUBBLOCKS]; // ring of mean squares
+  size_t subBlockHead;
+  size_t subBlockCount;
+
+  unsigned long histogram[LOUDNESS_HISTOGRAM_BINS];
+  unsigned long rangeHistogram[LOUDNESS_HISTOGRAM_BINS]; // short-term
+
+  float polyphase[TRUE_PEAK_OVERSAMPLING][TRUE_PEAK_TAPS_PER_PHASE];
+  // Twice the taps, every sample is written twice so that the newest
+  // TRUE_PEAK_TAPS_PER_PHASE samples are always contiguous.
+  float history[LOUDNESS_MAX_CHANNELS][2 * TRUE_PEAK_TAPS_PER_PHASE];
+  size_t historyHead;
+  float truePeak;
+
+  _Atomic float momentary;
+  _Atomic float shortTerm;
+  _Atomic float integrated;
+  _Atomic float truePeakDb;
+  _Atomic float range;
+} LoudnessMeter;
+
+// Resets the meter for a stream with the given format. Streams with more
+// than LOUDNESS_MAX_CHANNELS channels only meter the first ones.
+void loudnessInit(LoudnessMeter *meter, const unsigned int sampleRate,
+                  const unsigned int channels);
+
+void loudnessProcess(LoudnessMeter *meter, const float samples[],
+                     const unsigned int frames);
+
+LoudnessReadout loudnessRead(const LoudnessMeter *meter);
+
+#endif // LOUDNESS_H
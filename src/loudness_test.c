@@ -0,0 +1,128 @@
+#include "loudness.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define CHANNELS 2
+#define BLOCK 1024 // frames per loudnessProcess, as an audio callback
+#define TONE_HZ 1000.0
+#define FADE_SECONDS 0.01 // a sine cut in at full scale overshoots
+
+// A stretch of the stereo test signal at one level
+typedef struct {
+  float dbfs;
+  float seconds;
+} Segment;
+
+static LoudnessMeter METER;
+static float BLOCK_SAMPLES[BLOCK * CHANNELS];
+
+// Feeds a sine of `hz` at the levels of the segments in turn, the phase
+// running on across them, faded in, and returns the readout at the end
+static LoudnessReadout play(const unsigned int sampleRate, const double hz,
+                            const double phase, const Segment segments[],
+                            const size_t n) {
+  loudnessInit(&METER, sampleRate, CHANNELS);
+  unsigned long frame = 0;
+  for (size_t s = 0; s < n; ++s) {
+    const float amplitude = powf(10.0f, segments[s].dbfs / 20.0f);
+    unsigned long left = lround(segments[s].seconds * sampleRate);
+    while (left > 0) {
+      const unsigned int frames = left < BLOCK ? left : BLOCK;
+      for (unsigned int f = 0; f < frames; ++f, ++frame) {
+        const double t = (double)frame / sampleRate;
+        const double fade =
+            t < FADE_SECONDS ? 0.5 * (1.0 - cos(M_PI * t / FADE_SECONDS)) : 1.0;
+        const float x = amplitude * fade * sin(2.0 * M_PI * hz * t + phase);
+        for (int c = 0; c < CHANNELS; ++c)
+          BLOCK_SAMPLES[f * CHANNELS + c] = x;
+      }
+      loudnessProcess(&METER, BLOCK_SAMPLES, frames);
+      left -= frames;
+    }
+  }
+  return loudnessRead(&METER);
+}
+
+static bool near(const char *what, const float measured, const float expected,
+                 const float below, const float above) {
+  const bool ok =
+      measured >= expected - below && measured <= expected + above;
+  printf("  %-10s %7.2f, expected %.1f%s\n", what, measured, expected,
+         ok ? "" : "  WRONG");
+  return ok;
+}
+
+// EBU Tech 3341 minimum requirements: 1 kHz in both channels, the levels in
+// dBFS are the expected LUFS
+static bool tech3341(const unsigned int sampleRate, const char *name,
+                     const Segment segments[], const size_t n,
+                     const float expected, const bool windows) {
+  printf("%u Hz, Tech 3341 %s\n", sampleRate, name);
+  const LoudnessReadout r = play(sampleRate, TONE_HZ, 0.0, segments, n);
+  bool ok = near("integrated", r.integrated, expected, 0.1f, 0.1f);
+  if (windows) {
+    ok &= near("momentary", r.momentary, expected, 0.1f, 0.1f);
+    ok &= near("short-term", r.shortTerm, expected, 0.1f, 0.1f);
+  }
+  return ok;
+}
+
+// EBU Tech 3342 loudness range of the stepped sines
+static bool tech3342(const unsigned int sampleRate, const char *name,
+                     const Segment segments[], const size_t n,
+                     const float expected) {
+  printf("%u Hz, Tech 3342 %s\n", sampleRate, name);
+  const LoudnessReadout r = play(sampleRate, TONE_HZ, 0.0, segments, n);
+  return near("range", r.range, expected, 1.0f, 1.0f);
+}
+
+// EBU Tech 3341 true peak: a full scale sine whose samples miss the peak.
+// Tech 3341 allows -0.4 to +0.2 dB, the interpolation does better.
+static bool truePeak(const unsigned int sampleRate, const char *name,
+                     const double hz, const double phase) {
+  printf("%u Hz, Tech 3341 %s\n", sampleRate, name);
+  const Segment full[] = {{0.0f, 1.0f}};
+  const LoudnessReadout r = play(sampleRate, hz, phase, full, 1);
+  return near("true peak", r.truePeak, 0.0f, 0.1f, 0.1f);
+}
+
+int main(void) {
+  static const unsigned int RATES[] = {44100, 48000};
+  const Segment case1[] = {{-23.0f, 20.0f}};
+  const Segment case2[] = {{-33.0f, 20.0f}};
+  const Segment case3[] = {{-36.0f, 10.0f}, {-23.0f, 60.0f}, {-36.0f, 10.0f}};
+  const Segment case4[] = {{-72.0f, 10.0f},
+                           {-36.0f, 10.0f},
+                           {-23.0f, 60.0f},
+                           {-36.0f, 10.0f},
+                           {-72.0f, 10.0f}};
+  const Segment case5[] = {{-26.0f, 20.0f}, {-20.0f, 20.1f}, {-26.0f, 20.0f}};
+  const Segment range1[] = {{-20.0f, 20.0f}, {-30.0f, 20.0f}};
+  const Segment range2[] = {{-20.0f, 20.0f}, {-15.0f, 20.0f}};
+  const Segment range3[] = {{-40.0f, 20.0f}, {-20.0f, 20.0f}};
+  const Segment range4[] = {{-50.0f, 20.0f},
+                            {-35.0f, 20.0f},
+                            {-20.0f, 20.0f},
+                            {-35.0f, 20.0f},
+                            {-50.0f, 20.0f}};
+
+  int failed = 0;
+  for (size_t i = 0; i < sizeof(RATES) / sizeof(RATES[0]); ++i) {
+    const unsigned int rate = RATES[i];
+    failed |= !tech3341(rate, "case 1", case1, 1, -23.0f, true);
+    failed |= !tech3341(rate, "case 2", case2, 1, -33.0f, true);
+    failed |= !tech3341(rate, "case 3", case3, 3, -23.0f, false);
+    failed |= !tech3341(rate, "case 4", case4, 5, -23.0f, false);
+    failed |= !tech3341(rate, "case 5", case5, 3, -23.0f, false);
+    failed |= !tech3342(rate, "case 1", range1, 2, 10.0f);
+    failed |= !tech3342(rate, "case 2", range2, 2, 5.0f);
+    failed |= !tech3342(rate, "case 3", range3, 2, 20.0f);
+    failed |= !tech3342(rate, "case 4", range4, 5, 15.0f);
+    failed |= !truePeak(rate, "fs/4 at 45", rate / 4.0, M_PI / 4.0);
+    failed |= !truePeak(rate, "fs/6 at 60", rate / 6.0, M_PI / 3.0);
+  }
+
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
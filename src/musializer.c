@@ -1,14 +1,35 @@
 #include "musializer.h"
+#include "autogain.h"
+#include "chain.h"
+#include "chroma.h"
+#include "decimator.h"
+#include "envelope.h"
+#include "descriptors.h"
 #include "fft.h"
+#include "filterbank.h"
+#include "loudness.h"
+#include "onset.h"
+#include "pcm.h"
+#include "peaks.h"
+#include "preroll.h"
+#include "realtime.h"
+#include "ring.h"
+#include "spectrum.h"
+#include "timing.h"
+#include "triple.h"
 #include <assert.h>
 #include <errno.h>
 #include <pthread.h>
 #include <raylib.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <float.h>
+#include <inttypes.h>
+#include <stdint.h>
 
 #if defined(__EMSCRIPTEN__) || defined(__wasm__) || defined(__wasm32__) ||     \
     defined(__wasm64__)
@@ -28,35 +49,102 @@
 
 #define ARRAY_LENGTH(x) (sizeof(x) / sizeof(x[0]))
 
-static unsigned int CHANNELS = 2;
-
-typedef struct Frames {
-  // TODO: Check which is left and which is right
-  float left;
-  float right;
-} Frames;
-
-#define FRAME_BUFFER_CAPACITY (2 << 13)
-static Frames FRAME_BUFFER[FRAME_BUFFER_CAPACITY] = {0};
-static unsigned int FRAME_BUFFER_SIZE = 0;
-#define FRAME_BUFFER_SIZE_BYTES (FRAME_BUFFER_SIZE * sizeof(Frames))
-#define FRAME_BUFFER_UNINITIALIZED_ELEMS                                       \
-  (((long)FRAME_BUFFER_CAPACITY - (long)FRAME_BUFFER_SIZE < 0)                 \
-       ? 0                                                                     \
-       : (FRAME_BUFFER_CAPACITY - FRAME_BUFFER_SIZE))
-#define FRAME_BUFFER_UNINITIALIZED_BYTES                                       \
-  (FRAME_BUFFER_UNINITIALIZED_ELEMS * sizeof(Frames))
-#define FRAMES_TO_SAMPLES(frames) (frames * CHANNELS)
-#define SAMPLES_TO_FRAMES(frames) (frames / CHANNELS)
-
-static pthread_mutex_t BUFFER_LOCK;
+// Frames of the analysis window, a power of two, and the factor it is zero
+// padded by to the FFT size. Set with MUSIALIZER_ANALYSIS_WINDOW and
+// MUSIALIZER_ZERO_PAD, changed with '-'/'=' and 'Z' while playing.
+#define ANALYSIS_DEFAULT_WINDOW (2 << 13)
+#define ANALYSIS_MIN_WINDOW 2048
+#define ANALYSIS_MAX_WINDOW 65536
+#define ANALYSIS_DEFAULT_ZERO_PAD 2
+#define ANALYSIS_MAX_ZERO_PAD 4
+
+// The frame buffer holds this many analysis windows: the window plus the
+// pre-roll of a seek or a backlog of hops that were not analyzed yet
+#define FRAME_BUFFER_WINDOWS 4
+static float *FRAME_BUFFER = NULL;
+// Written by the audio callback, read by the analysis and the wave without
+// a lock. Frame indices count from the start of playback, the pre-rolls of
+// seeks included.
+static Ring FRAMES = {0};
+// While the render thread moves FRAMES and PREROLL to buffers of another
+// size, fillSampleBuffer leaves them alone instead of waiting, and its frames
+// are lost.
+static _Atomic bool FRAMES_HELD = false;
+static _Atomic bool FRAMES_WRITING = false;
+static _Atomic uint64_t HELD_FRAMES = 0;
+
+// What the analysis and the wave see of the channels, cycled with 'M'
+typedef enum Downmix {
+  DOWNMIX_MID,     // mean of all channels
+  DOWNMIX_SIDE,    // (left - right) / 2, silent for mono
+  DOWNMIX_CHANNEL, // the channel STATE->downmixChannel
+} Downmix;
 
 #define SMOOTHED_AMPLITUDES_SIZE SCREEN_WIDTH
 #define SHADOW_SIZE SCREEN_WIDTH
 
-#define FFT_SIZE (2 * FRAME_BUFFER_CAPACITY)
+#define ANALYSIS_DEFAULT_HOP 1024
+#define ANALYSIS_MIN_HOP 128
+#define ANALYSIS_MAX_HOP 8192
+#define ANALYSIS_MAX_HOPS_PER_UPDATE 8
+
+// What comes before a seek target, from seekMusic to fillSampleBuffer, which
+// writes it into the ring right before the first frames from the target.
+// The analysis then warms up on it in one go.
+#define PREROLL_WARM_FRAMES 16384 // analyzed before the target, in hops
+static float *PREROLL = NULL; // PREROLL_CAPACITY frames of DEVICE.channels
+static size_t PREROLL_CAPACITY = 0; // an analysis window plus the warm-up
+static size_t PREROLL_LENGTH = 0;
+static _Atomic bool PREROLL_PENDING = false;
+// Frames of the ring, set by fillSampleBuffer for the analysis
+static _Atomic uint64_t PREROLL_START = 0;
+static _Atomic uint64_t PREROLL_END = 0;
+static _Atomic unsigned long PREROLLS = 0;
+
+// The device plays this many periods after the one being filled. It is
+// miniaudio's default, raylib does not configure it.
+#define AUDIO_DEVICE_PERIODS 3
+
+// Shown with 'T' and written on exit, set with MUSIALIZER_TIMING_FILE
+#define TIMING_DEFAULT_FILE "musializer-timing.txt"
+
+// fillSampleBuffer hands its blocks to the stages of CHAIN, see startChain
+#define CHAIN_BLOCK_FRAMES 4096
+#define CHAIN_QUEUE_FRAMES (1 << 15) // to the stages off the audio thread
+static ProcessorChain CHAIN = {0};
+
+// Decoded audio that is buffered ahead of the device, in two halves that the
+// decoder thread refills in turn. Set with MUSIALIZER_DECODE_AHEAD_MS.
+#define DECODE_AHEAD_DEFAULT_SECONDS 0.2f
+#define DECODE_AHEAD_MIN_SECONDS 0.02f
+#define DECODE_AHEAD_NOMINAL_RATE 48000 // the buffer is sized before the
+                                        // music's rate is known
+// Cycled with 'X', after the gapless transition
+static const float CROSSFADE_STEPS[] = {2.0f, 5.0f, 10.0f}; // seconds
+
+#define SYNC_TRIM_STEP 0.005f // seconds
+#define SYNC_MAX_TRIM 0.5f    // seconds
 
 #define DEFAULT_MAX_AMPLITUDE 0.01
+#define AUTO_GAIN_DEFAULT_WINDOW 5.0f // seconds
+#define AUTO_GAIN_DEFAULT_DECAY 2.0f  // seconds, 0 to disable
+
+// Time constants of the envelope followers in seconds
+typedef struct SmoothingTimes {
+  float barAttack;
+  float barRelease;
+  float shadowAttack;
+  float shadowRelease;
+  float wave;
+} SmoothingTimes;
+
+static const SmoothingTimes DEFAULT_SMOOTHING_TIMES = {
+    .barAttack = 0.05f,
+    .barRelease = 0.1f,
+    .shadowAttack = 1.4f,
+    .shadowRelease = 1.4f,
+    .wave = 0.8f,
+};
 
 #define max(a, b) (a > b ? a : b)
 
@@ -68,20 +156,174 @@ typedef struct MusicFiles {
 
 static Music MUSIC = {0};
 
+// Raw PCM from stdin or a named pipe instead of the music files, configured
+// with environment variables:
+//   MUSIALIZER_PCM           path, or - for stdin
+//   MUSIALIZER_PCM_FORMAT    s16 (default) or f32
+//   MUSIALIZER_PCM_RATE      sample rate, default LIVE_DEFAULT_RATE
+//   MUSIALIZER_PCM_CHANNELS  default LIVE_DEFAULT_CHANNELS
+typedef struct LiveInput {
+  bool enabled;
+  const char *path; // from the environment, lives as long as the process
+  PcmSampleFormat format;
+  unsigned int sampleRate;
+  unsigned int channels;
+} LiveInput;
+
+#define LIVE_DEFAULT_RATE 48000
+#define LIVE_DEFAULT_CHANNELS 2
+
+static PcmInput LIVE = {0};
+// Of the music or the live input
+static unsigned int SAMPLE_RATE = 0;
+
+typedef enum DisplayMode {
+  DISPLAY_FREQUENCY,
+  DISPLAY_WAVE,
+  DISPLAY_FILTERBANK,
+  DISPLAY_MODE_COUNT,
+} DisplayMode;
+
+// Spectral resolution of the analysis, cycled with 'I' to compare them
+typedef enum Resolution {
+  RESOLUTION_FULL,         // the FFT size
+  RESOLUTION_REDUCED,      // 1 / REDUCED_FFT_FACTOR of it, linearly upsampled
+  RESOLUTION_INTERPOLATED, // the reduced FFT with sub-bin peaks
+  RESOLUTION_MULTIRATE,    // the reduced FFT, the bass from a decimated one
+  RESOLUTION_COUNT,
+} Resolution;
+
+#define REDUCED_FFT_FACTOR 4
+#define MAX_SPECTRAL_PEAKS 2048
+// The bass is analyzed at 1 / BASS_DECIMATION of the sample rate, which
+// gives the bins of the full FFT with one BASS_DECIMATION times smaller
+#define BASS_DECIMATION 8
+
+#define FILTERBANK_DEFAULT_BANDS 64
+#define FILTERBANK_MIN_BANDS 8
+#define FILTERBANK_BANDS_STEP 8
+#define FILTERBANK_MIN_HZ 40.0f
+#define FILTERBANK_MAX_HZ 16000.0f
+
+// The threads whose scheduling can be set, see scheduleThread
+typedef enum {
+  SCHEDULED_AUDIO, // that runs fillSampleBuffer
+  SCHEDULED_DECODER,
+  SCHEDULED_ANALYSIS,
+  SCHEDULED_THREADS,
+} ScheduledThread;
+
+// The stages of CHAIN, in their order
+typedef enum {
+  STAGE_FRAMES,   // into FRAMES, for the analysis and the wave
+  STAGE_LOUDNESS, // off the audio thread
+  STAGES,
+} Stage;
+
+static const char *STAGE_NAMES[STAGES] = {
+    [STAGE_FRAMES] = "FRAMES",
+    [STAGE_LOUDNESS] = "LOUDNESS",
+};
+
 typedef struct State {
   bool finished;
   bool reload;
-  bool useWave;
+  DisplayMode displayMode;
+  Resolution resolution;
+  Downmix downmix;
+  size_t downmixChannel;
+  FilterbankConfig filterbank;
   bool showHelpInfo;
   bool showHelp;
+  unsigned int analysisHop;    // frames between two analyzed spectra
+  unsigned int analysisWindow; // frames
+  unsigned int zeroPad;        // FFT size / analysisWindow
   float timePlayedSeconds;
   float maxAmplitude;
+  float autoGainWindowSeconds;
+  float autoGainDecaySeconds;
+  SmoothingTimes smoothing;
+  BeatInfo beat;
+  bool showChroma;
+  bool suppressHarmonics;
+  float chroma[CHROMA_PITCH_CLASSES]; // smoothed, maximum of one
+  int key;                            // estimated tonic pitch class
+  bool keyMinor;
+  bool showLoudness;
+  bool showSync;
+  float syncTrimSeconds;     // added to the estimated output latency
+  SpectralFeatures features; // of the latest analysis hop
+  bool showFeatures;
   Vector2 windowPosition;
   MusicFiles musicFiles;
+  LiveInput liveInput; // used while there are no music files
+  float decodeAheadSeconds;
+  float crossfadeSeconds; // between two tracks, 0 for a gapless transition
+  bool showTiming;
+  CallTiming audioTiming;  // of fillSampleBuffer
+  CallTiming refillTiming; // of the refills of MUSIC
+  CallTiming stageTimings[STAGES];
+  ThreadSchedule schedules[SCHEDULED_THREADS];
+  // Frames the analysis lost, refreshed every frame while the input plays
+  RingStats captureStats;
+  uint64_t skippedHops;
+  uint64_t heldFrames;
+  uint64_t skippedStageFrames;
 } State;
 
 static State *STATE = NULL;
 
+static const char *SCHEDULED_NAMES[SCHEDULED_THREADS] = {
+    [SCHEDULED_AUDIO] = "Audio callback",
+    [SCHEDULED_DECODER] = "Decoder",
+    [SCHEDULED_ANALYSIS] = "Analysis",
+};
+static const char *SCHEDULED_VARIABLES[SCHEDULED_THREADS] = {
+    [SCHEDULED_AUDIO] = "MUSIALIZER_SCHED_AUDIO",
+    [SCHEDULED_DECODER] = "MUSIALIZER_SCHED_DECODER",
+    [SCHEDULED_ANALYSIS] = "MUSIALIZER_SCHED_ANALYSIS",
+};
+// Written by scheduleThread before SCHEDULED is set, read by reportSchedules
+// after it is
+static char SCHEDULE_REPORTS[SCHEDULED_THREADS][REALTIME_REPORT_SIZE];
+static bool SCHEDULE_APPLIED[SCHEDULED_THREADS];
+static _Atomic bool SCHEDULED[SCHEDULED_THREADS];
+// Render thread
+static char SCHEDULE_REPORTED[SCHEDULED_THREADS][REALTIME_REPORT_SIZE];
+
+// Applies the schedule of `t` to the thread that runs it. The audio callback
+// does that itself on its first call, as raylib does not hand out its
+// thread; everything else right after starting the thread.
+static void scheduleThread(const ScheduledThread t, pthread_t thread) {
+  if (!realtimeRequested(&STATE->schedules[t]))
+    return;
+  SCHEDULE_APPLIED[t] = realtimeApply(thread, &STATE->schedules[t],
+                                      SCHEDULE_REPORTS[t],
+                                      REALTIME_REPORT_SIZE);
+  atomic_store_explicit(&SCHEDULED[t], true, memory_order_release);
+}
+
+// Before the thread of `t` is started or its callback attached
+static void unscheduleThread(const ScheduledThread t) {
+  atomic_store_explicit(&SCHEDULED[t], false, memory_order_relaxed);
+}
+
+// Prints what the threads got when it changes, so once for threads that are
+// started again and again with the same result
+static void reportSchedules(void) {
+  for (size_t t = 0; t < SCHEDULED_THREADS; ++t) {
+    if (!atomic_load_explicit(&SCHEDULED[t], memory_order_acquire) ||
+        strcmp(SCHEDULE_REPORTS[t], SCHEDULE_REPORTED[t]) == 0)
+      continue;
+    if (SCHEDULE_APPLIED[t])
+      printf("%s thread: %s\n", SCHEDULED_NAMES[t], SCHEDULE_REPORTS[t]);
+    else
+      fprintf(stderr, "WARNING: %s thread: %s\n", SCHEDULED_NAMES[t],
+              SCHEDULE_REPORTS[t]);
+    strcpy(SCHEDULE_REPORTED[t], SCHEDULE_REPORTS[t]);
+  }
+}
+
 static void unloadMusicFiles(void) {
   if (STATE->musicFiles.count > 0) {
     for (size_t i = 0; i < STATE->musicFiles.count; ++i)
@@ -221,38 +463,6 @@ static Color nextRainbowColor(int i, int n, bool reversed) {
   return lerpColorGammaCorrected(startColor, stopColor, t);
 }
 
-static bool lockBuffer(void) {
-  int err;
-  // Locking mutex
-  if ((err = pthread_mutex_lock(&BUFFER_LOCK)) != 0) {
-    printf("WARNING: Could not lock mutex: %s.", strerror(err));
-    return false;
-  }
-  return true;
-}
-
-static bool tryLockBuffer(void) {
-  int err;
-  if ((err = pthread_mutex_trylock(&BUFFER_LOCK)) != 0) {
-    if (err != EBUSY) {
-      fprintf(stderr, "WARNING: Failed trying to lock mutex: %s.",
-              strerror(err));
-    }
-    return false;
-  }
-  return true;
-}
-
-static void unlockBuffer(void) {
-  int err;
-  // Unlock mutex
-  if ((err = pthread_mutex_unlock(&BUFFER_LOCK)) != 0) {
-    fprintf(stderr, "FATAL: Could not unlock mutex. %s. Quitting program.",
-            strerror(err));
-    exit(EXIT_FAILURE); // panic
-  }
-}
-
 static inline float fmaxvf(const float x[], const size_t n) {
   assert(n > 0 && "Empty vector");
   float m = x[0];
@@ -280,82 +490,732 @@ static inline int nextFrequencyIndex(int k) {
   return (int)ceilf((float)k * EQUAL_TEMPERED_FACTOR);
 }
 
+// The analysis runs on its own thread (or, without threads, on the render
+// thread before drawing). The renderer hands it an AnalysisConfig and reads
+// back AnalysisResults, both through triple buffers. Everything between the
+// two is only touched by the analysis.
+
+// The settings of STATE the analysis depends on
+typedef struct AnalysisConfig {
+  DisplayMode displayMode;
+  Resolution resolution;
+  Downmix downmix;
+  size_t downmixChannel;
+  FilterbankConfig filterbank;
+  unsigned int hop;
+  unsigned int window;
+  unsigned int zeroPad;
+  SmoothingTimes smoothing;
+  float autoGainWindowSeconds;
+  float autoGainDecaySeconds;
+  bool suppressHarmonics;
+  float syncTrimSeconds;
+  unsigned long resets; // resetFilter calls so far
+} AnalysisConfig;
+
+// Smoothed bars of one analysis hop
+typedef struct AnalyzedSpectrum {
+  double time; // seconds of audio written when the analysis window ended
+  int numBars;
+  float amplitudes[SMOOTHED_AMPLITUDES_SIZE];
+  float shadows[SHADOW_SIZE];
+} AnalyzedSpectrum;
+
+typedef struct AnalysisResult {
+  // The previous and the latest spectrum, the renderer interpolates between
+  // them
+  AnalyzedSpectrum spectra[2];
+  float maxAmplitude;
+  BeatInfo beat;
+  float chroma[CHROMA_PITCH_CLASSES];
+  int key;
+  bool keyMinor;
+  SpectralFeatures features;
+} AnalysisResult;
+
+static AnalysisConfig ANALYSIS_CONFIG_SLOTS[3];
+static TripleBuffer ANALYSIS_CONFIGS = {0};
+static AnalysisResult ANALYSIS_RESULT_SLOTS[3];
+static TripleBuffer ANALYSIS_RESULTS = {0};
+static unsigned long ANALYSIS_RESETS = 0; // render thread
+static pthread_t ANALYSIS_THREAD;
+static bool ANALYSIS_THREADED = false;
+static _Atomic bool ANALYSIS_RUNNING = false;
+
+// Owned by the analysis
+static AnalysisConfig ANALYSIS_CONFIG = {0};
+static AnalysisResult ANALYSIS = {0};
 static float SMOOTHED_AMPLITUDES[SMOOTHED_AMPLITUDES_SIZE] = {0};
 static float SHADOWS[SHADOW_SIZE] = {0};
+static uint64_t NEXT_ANALYSIS_FRAME = 0;
+static _Atomic uint64_t SKIPPED_HOPS = 0; // by analyzeMusic to catch up
+static AutoGain AUTO_GAIN = {0};
+
+// The FFT state of the analysis, rebuilt when the window or its zero padding
+// change
+typedef struct AnalysisBuffers {
+  unsigned int window; // frames
+  unsigned int zeroPad;
+  size_t fftSize;             // window * zeroPad
+  float *samples;             // fftSize, for every FFT of a hop
+  float complex *frequencies; // fftSize
+  float *magnitudes;          // fftSize / 2, of the full resolution
+  float *reduced;             // of the FFT REDUCED_FFT_FACTOR times smaller
+  float *bass;                // of the FFT BASS_DECIMATION times smaller
+  float *downmix;             // input of the bass decimator
+} AnalysisBuffers;
+
+static AnalysisBuffers BUFFERS = {0};
+
+static void analysisBuffersFree(AnalysisBuffers *b) {
+  free(b->samples);
+  free(b->frequencies);
+  free(b->magnitudes);
+  free(b->reduced);
+  free(b->bass);
+  free(b->downmix);
+  *b = (AnalysisBuffers){0};
+}
 
-static void resetFilter(void) {
+// Allocates the buffers for a window of `window` frames zero padded by
+// `zeroPad`. Leaves `b` alone if there is not enough memory.
+static bool analysisBuffersInit(AnalysisBuffers *b, const unsigned int window,
+                                const unsigned int zeroPad) {
+  const size_t fftSize = (size_t)window * zeroPad;
+  AnalysisBuffers n = {
+      .window = window,
+      .zeroPad = zeroPad,
+      .fftSize = fftSize,
+      .samples = malloc(fftSize * sizeof(float)),
+      .frequencies = malloc(fftSize * sizeof(float complex)),
+      .magnitudes = malloc(fftSize / 2 * sizeof(float)),
+      .reduced = malloc(fftSize / REDUCED_FFT_FACTOR / 2 * sizeof(float)),
+      .bass = malloc(fftSize / BASS_DECIMATION / 2 * sizeof(float)),
+      .downmix = malloc((window + DECIMATOR_MAX_TAPS) * sizeof(float)),
+  };
+  if (n.samples == NULL || n.frequencies == NULL || n.magnitudes == NULL ||
+      n.reduced == NULL || n.bass == NULL || n.downmix == NULL) {
+    fprintf(stderr, "Could not allocate the analysis of a %u frame window\n",
+            window);
+    analysisBuffersFree(&n);
+    return false;
+  }
+  analysisBuffersFree(b);
+  *b = n;
+  return true;
+}
+
+// Owned by the render thread
+static float WAVE_ENVELOPE[SMOOTHED_AMPLITUDES_SIZE] = {0};
+static AutoGain WAVE_AUTO_GAIN = {0};
+
+// Feeds the peak of this update to a windowed peak tracker that scales the
+// bars or the wave, and returns the scale.
+static float updateMaxAmplitude(AutoGain *ag, const float peak,
+                                const double time) {
+  return max(DEFAULT_MAX_AMPLITUDE, autoGainUpdate(ag, peak, time));
+}
+
+// Forgets the smoothing state of the analysis, on the analysis side
+static void resetAnalysis(void) {
   for (int i = 0; i < max(SMOOTHED_AMPLITUDES_SIZE, SHADOW_SIZE); ++i) {
     if (i < SMOOTHED_AMPLITUDES_SIZE)
       SMOOTHED_AMPLITUDES[i] = 0.0f;
     if (i < SHADOW_SIZE)
       SHADOWS[i] = 0.0f;
   }
+  ANALYSIS.spectra[0].numBars = 0;
+  ANALYSIS.spectra[1].numBars = 0;
+  autoGainInit(&AUTO_GAIN, ANALYSIS_CONFIG.autoGainWindowSeconds,
+               ANALYSIS_CONFIG.autoGainDecaySeconds);
+  ANALYSIS.maxAmplitude = DEFAULT_MAX_AMPLITUDE;
+}
+
+// Hands the current settings to the analysis, on the render side
+static void publishAnalysisConfig(void) {
+  AnalysisConfig *config = tripleBack(&ANALYSIS_CONFIGS);
+  *config = (AnalysisConfig){
+      .displayMode = STATE->displayMode,
+      .resolution = STATE->resolution,
+      .downmix = STATE->downmix,
+      .downmixChannel = STATE->downmixChannel,
+      .filterbank = STATE->filterbank,
+      .hop = STATE->analysisHop,
+      .window = STATE->analysisWindow,
+      .zeroPad = STATE->zeroPad,
+      .smoothing = STATE->smoothing,
+      .autoGainWindowSeconds = STATE->autoGainWindowSeconds,
+      .autoGainDecaySeconds = STATE->autoGainDecaySeconds,
+      .suppressHarmonics = STATE->suppressHarmonics,
+      .syncTrimSeconds = STATE->syncTrimSeconds,
+      .resets = ANALYSIS_RESETS,
+  };
+  triplePublish(&ANALYSIS_CONFIGS);
+}
+
+static void resetFilter(void) {
+  for (int i = 0; i < SMOOTHED_AMPLITUDES_SIZE; ++i)
+    WAVE_ENVELOPE[i] = 0.0f;
+  autoGainInit(&WAVE_AUTO_GAIN, STATE->autoGainWindowSeconds,
+               STATE->autoGainDecaySeconds);
   STATE->maxAmplitude = DEFAULT_MAX_AMPLITUDE;
+  ++ANALYSIS_RESETS; // the analysis resets itself when it sees the change
 }
 
-static void drawFrequency(void) {
+// Channel weights of a downmix for the channels in the ring
+static void downmixWeights(const Downmix downmix, const size_t channel,
+                           float weights[RING_MAX_CHANNELS]) {
+  const size_t channels = FRAMES.channels;
+  for (size_t c = 0; c < RING_MAX_CHANNELS; ++c)
+    weights[c] = 0.0f;
+  switch (downmix) {
+  case DOWNMIX_MID:
+    for (size_t c = 0; c < channels; ++c)
+      weights[c] = 1.0f / channels;
+    break;
+  case DOWNMIX_SIDE:
+    if (channels >= 2) {
+      weights[0] = 0.5f;
+      weights[1] = -0.5f;
+    }
+    break;
+  case DOWNMIX_CHANNEL:
+    weights[channel] = 1.0f;
+    break;
+  }
+}
 
-  if (FRAME_BUFFER_SIZE == 0)
-    return; // Nothing to draw
+// Reads a downmix of the frames [start, start + frames)
+static bool readDownmix(const Downmix downmix, const size_t channel,
+                        const uint64_t start, const size_t frames,
+                        float out[]) {
+  float weights[RING_MAX_CHANNELS];
+  downmixWeights(downmix, channel, weights);
+  return ringReadMix(&FRAMES, weights, start, frames, out);
+}
 
-  if (!lockBuffer())
-    return;
+// Windows the first windowSize samples, zero pads them to fftSize, computes
+// their FFT and writes the magnitudes of the fftSize / 2 positive frequency
+// bins. They are scaled to the level a full ANALYSIS_DEFAULT_WINDOW gives a
+// tone, so that the bars keep their height when the window changes.
+static void windowedMagnitudes(float samples[], const unsigned int windowSize,
+                               const size_t fftSize, float magnitudes[]) {
+  for (unsigned int i = 0; i < windowSize; ++i)
+    samples[i] = hannWindow(samples[i], i, windowSize);
+  memset(&samples[windowSize], 0, (fftSize - windowSize) * sizeof(float));
+
+  // Compute FFT
+  fft(samples, BUFFERS.frequencies, fftSize);
+
+  spectrum(BUFFERS.frequencies, magnitudes, fftSize / 2, SPECTRUM_MAGNITUDE,
+           SPECTRUM_LINEAR);
+  const float scale =
+      (float)ANALYSIS_DEFAULT_WINDOW * BUFFERS.zeroPad / fftSize;
+  if (scale != 1.0f)
+    for (size_t k = 0; k < fftSize / 2; ++k)
+      magnitudes[k] *= scale;
+}
+
+// Windows the downmix of the fftSize / zeroPad frames before frame `end`
+// (the analysis window for the full FFT size) and writes the magnitudes of
+// its fftSize / 2 positive frequency bins. Fails if the window is no longer
+// in the frame buffer.
+static bool computeMagnitudes(const uint64_t end, const size_t fftSize,
+                              float magnitudes[]) {
+  const uint64_t written = ringWritten(&FRAMES);
+  const uint64_t bufferStart = ringOldest(&FRAMES);
+  if (end > written || end <= bufferStart)
+    return false;
+  const uint64_t windowFrames = fftSize / BUFFERS.zeroPad;
+  const uint64_t start =
+      end - bufferStart > windowFrames ? end - windowFrames : bufferStart;
+  const unsigned int windowSize = end - start;
+
+  if (!readDownmix(ANALYSIS_CONFIG.downmix, ANALYSIS_CONFIG.downmixChannel,
+                   start, windowSize, BUFFERS.samples))
+    return false; // overwritten while copying
+  windowedMagnitudes(BUFFERS.samples, windowSize, fftSize, magnitudes);
+  return true;
+}
+
+static Decimator BASS_DECIMATOR = {0};
+
+// Like computeMagnitudes for the full FFT size, but only for the lowest bins
+// that the decimator keeps free of aliases, which it returns (0 on failure).
+// The analysis window before `end` (and the filter's history) is decimated
+// by BASS_DECIMATION and goes through an FFT as many times smaller, whose
+// bins are as wide as those of the full one.
+static size_t computeBassMagnitudes(const uint64_t end, float magnitudes[]) {
+  if (BASS_DECIMATOR.factor != BASS_DECIMATION &&
+      !decimatorInit(&BASS_DECIMATOR, BASS_DECIMATION))
+    return 0;
+  const unsigned int windowSize = BUFFERS.window / BASS_DECIMATION;
+  const size_t fftSize = BUFFERS.fftSize / BASS_DECIMATION;
+  const size_t frames = decimatorInputSize(&BASS_DECIMATOR, windowSize);
+  if (end < frames)
+    return 0;
+
+  // The window ends half the filter length early
+  if (!readDownmix(ANALYSIS_CONFIG.downmix, ANALYSIS_CONFIG.downmixChannel,
+                   end - frames, frames, BUFFERS.downmix))
+    return 0;
+  decimate(&BASS_DECIMATOR, BUFFERS.downmix, BUFFERS.samples, windowSize);
+  windowedMagnitudes(BUFFERS.samples, windowSize, fftSize, magnitudes);
+  return BASS_DECIMATOR.passband * (fftSize / 2);
+}
 
-  float samples[FFT_SIZE] = {0};
-  float complex frequencies[FFT_SIZE];
-  assert(FFT_SIZE >= FRAME_BUFFER_SIZE && "You need to increase the FFT_SIZE");
-  for (unsigned int i = 0; i < FRAME_BUFFER_SIZE; ++i) {
-    samples[i] = hannWindow(FRAME_BUFFER[i].left, i,
-                            FRAME_BUFFER_SIZE); // only take left channel
+// Magnitudes of the fftSize / 2 bins at the configured resolution into
+// BUFFERS.magnitudes. The reduced resolutions are upsampled, so everything
+// after this sees the same bins.
+static bool analyzeSpectrum(const uint64_t end) {
+  float *magnitudes = BUFFERS.magnitudes;
+  if (ANALYSIS_CONFIG.resolution == RESOLUTION_FULL)
+    return computeMagnitudes(end, BUFFERS.fftSize, magnitudes);
+
+  const size_t reducedBins = BUFFERS.fftSize / REDUCED_FFT_FACTOR / 2;
+  if (!computeMagnitudes(end, BUFFERS.fftSize / REDUCED_FFT_FACTOR,
+                         BUFFERS.reduced))
+    return false;
+  SpectralPeak peaks[MAX_SPECTRAL_PEAKS];
+  const size_t count =
+      ANALYSIS_CONFIG.resolution == RESOLUTION_INTERPOLATED
+          ? peaksFind(BUFFERS.reduced, reducedBins, peaks, MAX_SPECTRAL_PEAKS)
+          : 0;
+  peaksUpsample(BUFFERS.reduced, reducedBins, peaks, count,
+                REDUCED_FFT_FACTOR, BUFFERS.zeroPad, magnitudes);
+
+  if (ANALYSIS_CONFIG.resolution == RESOLUTION_MULTIRATE) {
+    // The bass bins replace the upsampled ones, which are just as wide
+    const size_t bins = computeBassMagnitudes(end, BUFFERS.bass);
+    memcpy(magnitudes, BUFFERS.bass, bins * sizeof(float));
   }
+  return true;
+}
 
-  unlockBuffer();
+// Natural logarithm of the bar amplitudes, 0 for empty bars
+static void logBars(const float amplitudes[], float logAmplitudes[],
+                    const int numBars) {
+  spectrumLog(amplitudes, logAmplitudes, numBars);
+  for (int i = 0; i < numBars; ++i)
+    if (amplitudes[i] <= 0.0f)
+      logAmplitudes[i] = 0.0f;
+}
 
-  // Compute FFT
-  fft(samples, frequencies, FFT_SIZE);
+// Smooths the log bar amplitudes into SMOOTHED_AMPLITUDES and SHADOWS, `dt`
+// seconds after the previous call.
+static void smoothBars(const float logAmplitudes[], const int numBars,
+                       const float dt) {
+  assert(numBars <= SMOOTHED_AMPLITUDES_SIZE && numBars <= SHADOW_SIZE &&
+         "You need to increase the SMOOTHED_AMPLITUDES_SIZE and SHADOW_SIZE");
+
+  const SmoothingTimes *times = &ANALYSIS_CONFIG.smoothing;
+  envelopeApply(SMOOTHED_AMPLITUDES, logAmplitudes, numBars,
+                envelopeCoefficients(times->barAttack, times->barRelease, dt));
+  for (int i = 0; i < numBars; ++i)
+    if (SMOOTHED_AMPLITUDES[i] < 0.0f)
+      SMOOTHED_AMPLITUDES[i] = 0.0f;
+
+  envelopeApply(
+      SHADOWS, logAmplitudes, numBars,
+      envelopeCoefficients(times->shadowAttack, times->shadowRelease, dt));
+  for (int i = 0; i < numBars; ++i)
+    if (SHADOWS[i] - SMOOTHED_AMPLITUDES[i] < 0.0f)
+      SHADOWS[i] = SMOOTHED_AMPLITUDES[i];
+}
+
+// Of the FFT of a zero padded ANALYSIS_DEFAULT_WINDOW, the same frequency
+// for other sizes
+#define FREQUENCY_BUCKETS_START_INDEX 20
+
+static int bucketsStartIndex(const size_t fftSize) {
+  const int k = (uint64_t)FREQUENCY_BUCKETS_START_INDEX * fftSize /
+                (ANALYSIS_DEFAULT_WINDOW * ANALYSIS_DEFAULT_ZERO_PAD);
+  return k > 0 ? k : 1;
+}
+
+// After the last bin of the bucket that starts at bin k. The last bucket
+// ends with the spectrum, the one after it would start beyond it.
+static int bucketEnd(const int k) {
+  const int end = nextFrequencyIndex(k);
+  const int bins = BUFFERS.fftSize / 2;
+  return end < bins ? end : bins;
+}
 
+static int bucketFrequencies(const float magnitudes[], float buckets[]) {
   int numFrequencyBuckets = 0;
-  const int startIndex = 20;
+  const int startIndex = bucketsStartIndex(BUFFERS.fftSize);
   for (int k = startIndex, i = 0;
-       k < FFT_SIZE / 2 && i < SMOOTHED_AMPLITUDES_SIZE;
+       (size_t)k < BUFFERS.fftSize / 2 && i < SMOOTHED_AMPLITUDES_SIZE;
        k = nextFrequencyIndex(k), ++i) {
     ++numFrequencyBuckets;
     float f = 0;
     int n = 0;
-    for (int j = k; j < nextFrequencyIndex(k); ++j) {
-      f += cabsf(frequencies[j]);
+    const int end = bucketEnd(k);
+    for (int j = k; j < end; ++j) {
+      f += magnitudes[j];
       ++n;
     }
-    if (f > 0.0f && n != 0)
-      f = logf(f / n);
+    buckets[i] = n != 0 ? f / n : 0.0f;
+  }
+  return numFrequencyBuckets;
+}
 
-    const float smoothFactor = 10.0f;
-    const float shadowFactor = 0.7f;
-    SMOOTHED_AMPLITUDES[i] +=
-        (f - SMOOTHED_AMPLITUDES[i]) * smoothFactor * GetFrameTime();
-    SHADOWS[i] += (f - SHADOWS[i]) * shadowFactor * GetFrameTime();
+// Center frequencies of the buckets of bucketFrequencies
+static int bucketCenters(float centerHz[]) {
+  const float binHz = (float)SAMPLE_RATE / BUFFERS.fftSize;
+  int numFrequencyBuckets = 0;
+  for (int k = bucketsStartIndex(BUFFERS.fftSize), i = 0;
+       (size_t)k < BUFFERS.fftSize / 2 && i < SMOOTHED_AMPLITUDES_SIZE;
+       k = nextFrequencyIndex(k), ++i) {
+    ++numFrequencyBuckets;
+    centerHz[i] = 0.5f * (k + bucketEnd(k) - 1) * binHz;
+  }
+  return numFrequencyBuckets;
+}
 
-    if (SMOOTHED_AMPLITUDES[i] < 0.0f)
-      SMOOTHED_AMPLITUDES[i] = 0.0f;
+static LoudnessMeter LOUDNESS = {0};
+static ChromaMap CHROMA_MAP = {0};
+static unsigned int CHROMA_MAP_SAMPLE_RATE = 0;
+static size_t CHROMA_MAP_FFT_SIZE = 0;
+
+#define CHROMA_ATTACK_SECONDS 0.05f
+#define CHROMA_RELEASE_SECONDS 0.3f
+
+// Folds the frequency buckets into the smoothed chroma and estimates the key
+static void analyzeChroma(const float buckets[], const int numBuckets,
+                          const float dt) {
+  if (CHROMA_MAP_SAMPLE_RATE != SAMPLE_RATE ||
+      CHROMA_MAP_FFT_SIZE != BUFFERS.fftSize) {
+    float centerHz[SMOOTHED_AMPLITUDES_SIZE];
+    if (!chromaMapInit(&CHROMA_MAP, centerHz, bucketCenters(centerHz)))
+      return;
+    CHROMA_MAP_SAMPLE_RATE = SAMPLE_RATE;
+    CHROMA_MAP_FFT_SIZE = BUFFERS.fftSize;
+  }
+  if ((size_t)numBuckets != CHROMA_MAP.bands)
+    return;
 
-    if (SHADOWS[i] - SMOOTHED_AMPLITUDES[i] < 0.0f)
-      SHADOWS[i] = SMOOTHED_AMPLITUDES[i];
+  float chroma[CHROMA_PITCH_CLASSES];
+  chromaCompute(&CHROMA_MAP, buckets, ANALYSIS_CONFIG.suppressHarmonics,
+                chroma);
+  envelopeApply(ANALYSIS.chroma, chroma, CHROMA_PITCH_CLASSES,
+                envelopeCoefficients(CHROMA_ATTACK_SECONDS,
+                                     CHROMA_RELEASE_SECONDS, dt));
+  ANALYSIS.key = chromaKey(ANALYSIS.chroma, &ANALYSIS.keyMinor);
+}
 
-    STATE->maxAmplitude = max(STATE->maxAmplitude, SMOOTHED_AMPLITUDES[i]);
+static Filterbank FILTERBANK = {0};
+
+static bool filterbankOutdated(void) {
+  const FilterbankConfig *want = &ANALYSIS_CONFIG.filterbank;
+  const FilterbankConfig *have = &FILTERBANK.config;
+  return FILTERBANK.weights == NULL || want->scale != have->scale ||
+         want->bands != have->bands || want->minHz != have->minHz ||
+         want->maxHz != have->maxHz ||
+         FILTERBANK.binHz != (float)SAMPLE_RATE / BUFFERS.fftSize;
+}
+
+static int filterbankBands(const float magnitudes[], float bands[]) {
+  if (filterbankOutdated()) {
+    if (!filterbankInit(&FILTERBANK, ANALYSIS_CONFIG.filterbank,
+                        BUFFERS.fftSize / 2,
+                        (float)SAMPLE_RATE / BUFFERS.fftSize))
+      return 0;
+    resetAnalysis();
   }
+  filterbankApply(&FILTERBANK, magnitudes, bands);
+  return FILTERBANK.config.bands;
+}
 
-  const int w =
-      numFrequencyBuckets > 0 ? SCREEN_WIDTH / numFrequencyBuckets : 1;
+static OnsetDetector ONSETS = {0};
+static DescriptorExtractor DESCRIPTORS = {0};
 
-  assert(numFrequencyBuckets <= SMOOTHED_AMPLITUDES_SIZE &&
-         numFrequencyBuckets <= SHADOW_SIZE &&
-         "You need to increase the SMOOTHED_AMPLITUDES_SIZE and SHADOW_SIZE");
+// Spectral descriptors of the same magnitudes the bars are made of
+static void analyzeFeatures(const float magnitudes[]) {
+  const float binHz = (float)SAMPLE_RATE / BUFFERS.fftSize;
+  if ((DESCRIPTORS.bins != BUFFERS.fftSize / 2 ||
+       DESCRIPTORS.binHz != binHz) &&
+      !descriptorsInit(&DESCRIPTORS, BUFFERS.fftSize / 2, binHz)) {
+    ANALYSIS.features = (SpectralFeatures){0};
+    return;
+  }
+  descriptorsCompute(&DESCRIPTORS, magnitudes, &ANALYSIS.features);
+}
+
+// Analyzes the window ending at frame `end` and appends the smoothed bars,
+// onsets and beats to ANALYSIS.
+static void analyzeHop(const uint64_t end, const float dt) {
+  if (!analyzeSpectrum(end))
+    return;
+  const float *magnitudes = BUFFERS.magnitudes;
+  ringConsume(&FRAMES, end);
+
+  analyzeFeatures(magnitudes);
+
+  float bars[SMOOTHED_AMPLITUDES_SIZE];
+  const int numBars = ANALYSIS_CONFIG.displayMode == DISPLAY_FILTERBANK
+                          ? filterbankBands(magnitudes, bars)
+                          : bucketFrequencies(magnitudes, bars);
+  float logAmplitudes[SMOOTHED_AMPLITUDES_SIZE];
+  logBars(bars, logAmplitudes, numBars);
+  smoothBars(logAmplitudes, numBars, dt);
+  if (ANALYSIS_CONFIG.displayMode == DISPLAY_FREQUENCY)
+    analyzeChroma(bars, numBars, dt);
+
+  const double time = (double)end / SAMPLE_RATE;
+  onsetUpdate(&ONSETS, logAmplitudes, numBars, time, dt);
+  ANALYSIS.beat = ONSETS.info;
+
+  ANALYSIS.spectra[0] = ANALYSIS.spectra[1];
+  AnalyzedSpectrum *latest = &ANALYSIS.spectra[1];
+  latest->time = time;
+  ANALYSIS.maxAmplitude = updateMaxAmplitude(
+      &AUTO_GAIN,
+      numBars > 0 ? fmaxvf(SMOOTHED_AMPLITUDES, numBars) : 0.0f, time);
+  latest->numBars = numBars;
+  memcpy(latest->amplitudes, SMOOTHED_AMPLITUDES, numBars * sizeof(float));
+  memcpy(latest->shadows, SHADOWS, numBars * sizeof(float));
+}
+
+static uint64_t framesWritten(void) { return ringWritten(&FRAMES); }
+
+static double monotonicSeconds(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// The frame that is at the DAC right now
+typedef struct Playback {
+  double frame;
+  double latency; // seconds it is behind the newest written frame
+} Playback;
+
+// The frames of a callback are played after the AUDIO_DEVICE_PERIODS
+// periods the device has buffered, each as long as the callback's burst, and
+// playback advances in real time since then. When the callbacks stop (the
+// live input ended) it runs into the newest frame and stays there.
+static Playback playbackPosition(const float trimSeconds) {
+  RingStamp stamp;
+  if (!ringLatestStamp(&FRAMES, &stamp))
+    return (Playback){0};
+  const double rate = SAMPLE_RATE;
+  // The live input is heard when it arrives
+  const double periods = pcmIsOpen(&LIVE) ? 0.0 : AUDIO_DEVICE_PERIODS;
+  const double latency = periods * (double)stamp.frames / rate + trimSeconds;
+  double frame =
+      stamp.frame + ((monotonicSeconds() - stamp.time) - latency) * rate;
+  if (frame > stamp.frame)
+    frame = stamp.frame;
+  if (frame < 0.0)
+    frame = 0.0;
+  return (Playback){.frame = frame, .latency = latency};
+}
+
+// Runs one analysis per configured hop of new frames, independent of the
+// frame rate. Smoothing advances by the hop duration, so the result does not
+// depend on how often this is called. If the analysis fell far behind, only
+// the last ANALYSIS_MAX_HOPS_PER_UPDATE hops are analyzed. Returns whether
+// there was any.
+static bool analyzeMusic(const uint64_t written) {
+  const unsigned int hop = ANALYSIS_CONFIG.hop;
+  const float dt = (float)hop / SAMPLE_RATE;
+
+  if (NEXT_ANALYSIS_FRAME + (uint64_t)ANALYSIS_MAX_HOPS_PER_UPDATE * hop <=
+      written) {
+    const uint64_t next =
+        written - (uint64_t)(ANALYSIS_MAX_HOPS_PER_UPDATE - 1) * hop;
+    atomic_fetch_add_explicit(&SKIPPED_HOPS, (next - NEXT_ANALYSIS_FRAME) / hop,
+                              memory_order_relaxed);
+    NEXT_ANALYSIS_FRAME = next;
+  }
+
+  bool analyzed = false;
+  for (; NEXT_ANALYSIS_FRAME <= written; NEXT_ANALYSIS_FRAME += hop) {
+    analyzeHop(NEXT_ANALYSIS_FRAME, dt);
+    analyzed = true;
+  }
+  return analyzed;
+}
+
+// Analyzes the pre-roll of a seek at once, from a clean state, so that the
+// bars have settled when the frames after it are played
+static void warmUp(const uint64_t start, const uint64_t end) {
+  resetAnalysis();
+  const unsigned int hop = ANALYSIS_CONFIG.hop;
+  const float dt = (float)hop / SAMPLE_RATE;
+  // From the first window that holds nothing from before the seek
+  uint64_t frame = start + BUFFERS.window < end ? start + BUFFERS.window : end;
+  for (; frame <= end; frame += hop)
+    analyzeHop(frame, dt);
+  NEXT_ANALYSIS_FRAME = frame;
+}
+
+// Rebuilds BUFFERS for the window of ANALYSIS_CONFIG and warms the analysis
+// up on the frames before where it was, so that the bars go on with the new
+// window. Keeps the old buffers if there is not enough memory. Returns
+// whether it rebuilt them.
+static bool resizeAnalysis(const uint64_t written) {
+  static unsigned int failedWindow = 0, failedZeroPad = 0; // not retried
+  const unsigned int window = ANALYSIS_CONFIG.window;
+  const unsigned int zeroPad = ANALYSIS_CONFIG.zeroPad;
+  if (window == failedWindow && zeroPad == failedZeroPad)
+    return false;
+  if (!analysisBuffersInit(&BUFFERS, window, zeroPad)) {
+    failedWindow = window;
+    failedZeroPad = zeroPad;
+    return false;
+  }
+  failedWindow = failedZeroPad = 0;
+
+  const unsigned int hop = ANALYSIS_CONFIG.hop;
+  uint64_t end = NEXT_ANALYSIS_FRAME > hop ? NEXT_ANALYSIS_FRAME - hop : 0;
+  end = end < written ? end : written;
+  const uint64_t oldest = ringOldest(&FRAMES);
+  const uint64_t span = window + PREROLL_WARM_FRAMES;
+  if (end > oldest)
+    warmUp(end - oldest > span ? end - span : oldest, end);
+  else
+    resetAnalysis();
+  return true;
+}
+
+// Picks up the latest settings, analyzes the new hops and publishes the
+// result. Returns false if there was nothing to do.
+static bool analysisStep(void) {
+  ANALYSIS_CONFIG = *(const AnalysisConfig *)tripleFront(&ANALYSIS_CONFIGS);
+  static unsigned long resetsSeen = 0;
+  if (ANALYSIS_CONFIG.resets != resetsSeen) {
+    resetsSeen = ANALYSIS_CONFIG.resets;
+    resetAnalysis();
+  }
+  static unsigned long prerollsSeen = 0;
+  const unsigned long prerolls =
+      atomic_load_explicit(&PREROLLS, memory_order_acquire);
+  const bool preroll = prerolls != prerollsSeen;
+  prerollsSeen = prerolls;
+
+  const uint64_t written = framesWritten();
+  if (ANALYSIS_CONFIG.displayMode == DISPLAY_WAVE) {
+    NEXT_ANALYSIS_FRAME = written + ANALYSIS_CONFIG.hop; // nothing to show
+    return false;
+  }
+  const bool resized = (ANALYSIS_CONFIG.window != BUFFERS.window ||
+                        ANALYSIS_CONFIG.zeroPad != BUFFERS.zeroPad) &&
+                       resizeAnalysis(written);
+  if (BUFFERS.fftSize == 0)
+    return false; // nothing to analyze with
+  if (preroll)
+    warmUp(atomic_load_explicit(&PREROLL_START, memory_order_relaxed),
+           atomic_load_explicit(&PREROLL_END, memory_order_relaxed));
+  // Up to a hop past the DAC, so that the played frame lies between the two
+  // latest spectra
+  const uint64_t target =
+      (uint64_t)playbackPosition(ANALYSIS_CONFIG.syncTrimSeconds).frame +
+      ANALYSIS_CONFIG.hop;
+  if (!analyzeMusic(target < written ? target : written) && !preroll &&
+      !resized)
+    return false;
+
+  memcpy(tripleBack(&ANALYSIS_RESULTS), &ANALYSIS, sizeof(ANALYSIS));
+  triplePublish(&ANALYSIS_RESULTS);
+  return true;
+}
+
+#define ANALYSIS_IDLE_MICROSECONDS 1000
+
+#if !FOR_WASM
+static void *analysisWorker(void *arg) {
+  (void)arg;
+  const struct timespec idle = {.tv_sec = 0,
+                                .tv_nsec = ANALYSIS_IDLE_MICROSECONDS * 1000};
+  while (atomic_load_explicit(&ANALYSIS_RUNNING, memory_order_acquire))
+    if (!analysisStep())
+      nanosleep(&idle, NULL);
+  return NULL;
+}
+#endif // FOR_WASM
+
+// Starts the worker, which goes on where the analysis is. Without threads
+// (the web build) drawFrequency runs the analysis itself.
+static void runAnalysis(void) {
+  ANALYSIS_THREADED = false;
+#if !FOR_WASM
+  atomic_store_explicit(&ANALYSIS_RUNNING, true, memory_order_release);
+  unscheduleThread(SCHEDULED_ANALYSIS);
+  const int err = pthread_create(&ANALYSIS_THREAD, NULL, analysisWorker, NULL);
+  if (err == 0) {
+    ANALYSIS_THREADED = true;
+    scheduleThread(SCHEDULED_ANALYSIS, ANALYSIS_THREAD);
+  } else
+    fprintf(stderr, "WARNING: Analysis runs on the render thread: %s\n",
+            strerror(err));
+#endif
+}
 
-  for (int i = 0; i < numFrequencyBuckets; ++i) {
-    const float f = SMOOTHED_AMPLITUDES[i];
+// Resets the analysis for a new stream and starts the worker
+static void startAnalysis(void) {
+  NEXT_ANALYSIS_FRAME = STATE->analysisHop;
+  atomic_store_explicit(&SKIPPED_HOPS, 0, memory_order_relaxed);
+  onsetInit(&ONSETS, 0.0);
+  memset(&ANALYSIS, 0, sizeof(ANALYSIS));
+  ANALYSIS.maxAmplitude = DEFAULT_MAX_AMPLITUDE;
+  STATE->beat = ONSETS.info;
+
+  ANALYSIS_CONFIG = (AnalysisConfig){0};
+  tripleInit(&ANALYSIS_CONFIGS, ANALYSIS_CONFIG_SLOTS, sizeof(AnalysisConfig),
+             &ANALYSIS_CONFIG);
+  publishAnalysisConfig();
+  tripleInit(&ANALYSIS_RESULTS, ANALYSIS_RESULT_SLOTS, sizeof(AnalysisResult),
+             &ANALYSIS);
+  runAnalysis();
+}
+
+static void stopAnalysis(void) {
+  if (!ANALYSIS_THREADED)
+    return;
+  atomic_store_explicit(&ANALYSIS_RUNNING, false, memory_order_release);
+  pthread_join(ANALYSIS_THREAD, NULL);
+  ANALYSIS_THREADED = false;
+}
+
+// Measured by the last draw for drawSync
+static Playback PLAYBACK = {0};
+static double AV_OFFSET = 0.0; // seconds the drawn audio is ahead of the DAC
+
+// Interpolates the spectrum at `time`, the playback time. Returns the number
+// of bars and sets `drawnTime` to the time it could actually draw.
+static int interpolateSpectra(const AnalysisResult *result, const double time,
+                              float amplitudes[], float shadows[],
+                              double *drawnTime) {
+  const AnalyzedSpectrum *previous = &result->spectra[0];
+  const AnalyzedSpectrum *latest = &result->spectra[1];
+
+  float t = 1.0f;
+  if (previous->numBars == latest->numBars && latest->time > previous->time)
+    t = (time - previous->time) / (latest->time - previous->time);
+  t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+  *drawnTime = t < 1.0f ? previous->time + (latest->time - previous->time) * t
+                        : latest->time;
+
+  for (int i = 0; i < latest->numBars; ++i) {
+    const float a = t < 1.0f ? previous->amplitudes[i] : 0.0f;
+    const float s = t < 1.0f ? previous->shadows[i] : 0.0f;
+    amplitudes[i] = a + (latest->amplitudes[i] - a) * t;
+    shadows[i] = s + (latest->shadows[i] - s) * t;
+  }
+  return latest->numBars;
+}
+
+static void drawBars(const float amplitudes[], const float shadows[],
+                     const int numBars) {
+  const int w = numBars > 0 ? SCREEN_WIDTH / numBars : 1;
+
+  for (int i = 0; i < numBars; ++i) {
+    const float f = amplitudes[i];
 
     const bool reversed_rainbow = true;
-    Color color = nextRainbowColor(i, numFrequencyBuckets, reversed_rainbow);
+    Color color = nextRainbowColor(i, numBars, reversed_rainbow);
 
     const float t = f / STATE->maxAmplitude;
     const int h = (float)SCREEN_HEIGHT * t;
@@ -384,7 +1244,7 @@ static void drawFrequency(void) {
                lineWidth, color);
     DrawCircle(x, SCREEN_HEIGHT - shrinkFactor * h, radius, color);
 
-    const float fShadow = SHADOWS[i];
+    const float fShadow = shadows[i];
 
     const float tShadow = fShadow / STATE->maxAmplitude;
     const int hShadow = (float)SCREEN_HEIGHT * tShadow;
@@ -399,28 +1259,159 @@ static void drawFrequency(void) {
   }
 }
 
+// Pulses a dot on every beat and shows the tempo
+static void drawBeat(const double time) {
+  const BeatInfo *beat = &STATE->beat;
+  if (beat->beats == 0 || beat->lastBeat > time)
+    return;
+
+  const float pulseSeconds = 0.15f;
+  const float pulse = expf(-(time - beat->lastBeat) / pulseSeconds);
+  DrawCircle(SCREEN_WIDTH - 20, 20, 4.0f + 4.0f * pulse,
+             Fade(WHITE, 0.2f + 0.8f * pulse));
+
+  if (beat->bpm > 0.0f) {
+    char label[16];
+    snprintf(label, sizeof(label), "%.0f BPM", beat->bpm);
+    DrawText(label, SCREEN_WIDTH - 40 - MeasureText(label, 10), 15, 10, GRAY);
+  }
+}
+
+// One cell per pitch class, coloured along the circle of fifths, plus the key
+static void drawChroma(void) {
+  const int cell = 12;
+  for (int c = 0; c < CHROMA_PITCH_CLASSES; ++c) {
+    const float hue = (c * 7 % CHROMA_PITCH_CLASSES) * 30.0f;
+    const Color color = ColorFromHSV(hue, 0.8f, 1.0f);
+    DrawRectangle(10 + c * (cell + 2), 10, cell, cell,
+                  Fade(color, 0.1f + 0.9f * STATE->chroma[c]));
+  }
+  char label[16];
+  snprintf(label, sizeof(label), "%s %s", chromaPitchName(STATE->key),
+           STATE->keyMinor ? "MINOR" : "MAJOR");
+  DrawText(label, 10 + CHROMA_PITCH_CLASSES * (cell + 2) + 6, 11, 10, GRAY);
+}
+
+// EBU R128 readout of the audio callback's meter
+static void drawLoudness(void) {
+  const LoudnessReadout r = loudnessRead(&LOUDNESS);
+  char label[112];
+  snprintf(label, sizeof(label),
+           "M %.1f  S %.1f  I %.1f LUFS  LRA %.1f LU  TP %.1f DBTP",
+           r.momentary, r.shortTerm, r.integrated, r.range, r.truePeak);
+  DrawText(label, 10, SCREEN_HEIGHT - 20, 10, GRAY);
+}
+
+// Descriptors of the latest hop, and the share of the power in each band
+static void drawFeatures(void) {
+  const SpectralFeatures *f = &STATE->features;
+  char label[96];
+  snprintf(label, sizeof(label),
+           "CENTROID %.0f HZ  ROLLOFF %.0f HZ  FLATNESS %.2f  FLUX %.2f",
+           f->centroid, f->rolloff, f->flatness, f->flux);
+  DrawText(label, 10, 30, 10, GRAY);
+  const int width = 100;
+  for (int b = 0; b < DESCRIPTORS_BANDS; ++b) {
+    const float share =
+        f->energy > 0.0f ? f->bandEnergies[b] / f->energy : 0.0f;
+    const int y = 45 + 12 * b;
+    DrawText(descriptorsBandName(b), 10, y, 10, GRAY);
+    DrawRectangle(80, y + 1, width * share, 8, Fade(GRAY, 0.6f));
+  }
+}
+
+static bool defaultResolution(void) {
+  return STATE->resolution == RESOLUTION_FULL &&
+         STATE->analysisWindow == ANALYSIS_DEFAULT_WINDOW &&
+         STATE->zeroPad == ANALYSIS_DEFAULT_ZERO_PAD;
+}
+
+static void drawResolution(void) {
+  char label[64];
+  const unsigned int fftSize = STATE->analysisWindow * STATE->zeroPad;
+  snprintf(label, sizeof(label), "WINDOW %u  FFT %u%s", STATE->analysisWindow,
+           STATE->resolution == RESOLUTION_FULL ? fftSize
+                                                : fftSize / REDUCED_FFT_FACTOR,
+           STATE->resolution == RESOLUTION_INTERPOLATED ? " + PEAKS"
+           : STATE->resolution == RESOLUTION_MULTIRATE  ? " + BASS"
+                                                        : "");
+  DrawText(label, SCREEN_WIDTH - 10 - MeasureText(label, 10), 35, 10, GRAY);
+}
+
+static void drawFrequency(void) {
+  if (!ANALYSIS_THREADED)
+    analysisStep();
+  const AnalysisResult *result = tripleFront(&ANALYSIS_RESULTS);
+  STATE->maxAmplitude = result->maxAmplitude;
+  STATE->beat = result->beat;
+  memcpy(STATE->chroma, result->chroma, sizeof(STATE->chroma));
+  STATE->key = result->key;
+  STATE->keyMinor = result->keyMinor;
+  STATE->features = result->features;
+
+  PLAYBACK = playbackPosition(STATE->syncTrimSeconds);
+  const double time = PLAYBACK.frame / SAMPLE_RATE;
+  float amplitudes[SMOOTHED_AMPLITUDES_SIZE];
+  float shadows[SHADOW_SIZE];
+  double drawnTime;
+  const int numBars =
+      interpolateSpectra(result, time, amplitudes, shadows, &drawnTime);
+  AV_OFFSET = drawnTime - time;
+  drawBars(amplitudes, shadows, numBars);
+  drawBeat(time);
+  if (!defaultResolution())
+    drawResolution();
+  if (STATE->showChroma && STATE->displayMode == DISPLAY_FREQUENCY)
+    drawChroma();
+  if (STATE->showFeatures)
+    drawFeatures();
+}
+
+static void drawFilterbank(void) {
+  drawFrequency(); // analyzeHop selects the filterbank bands
+
+  char label[64];
+  snprintf(label, sizeof(label), "%s %zu BANDS  %.0f-%.0f HZ",
+           filterbankScaleName(STATE->filterbank.scale),
+           STATE->filterbank.bands, STATE->filterbank.minHz,
+           STATE->filterbank.maxHz);
+  DrawText(label, 10, 10, 10, GRAY);
+}
+
 static void drawWave(void) {
-  if (FRAME_BUFFER_SIZE == 0)
+  const long dx = 2;
+  PLAYBACK = playbackPosition(STATE->syncTrimSeconds);
+  const uint64_t played = PLAYBACK.frame;
+  AV_OFFSET = (played - PLAYBACK.frame) / SAMPLE_RATE;
+  const long available =
+      played < SCREEN_WIDTH ? (long)played : (long)SCREEN_WIDTH;
+  float recent[SCREEN_WIDTH];
+  if (available == 0 ||
+      !readDownmix(STATE->downmix, STATE->downmixChannel, played - available,
+                   available, recent))
     return; // Nothing to draw
+  ringConsume(&FRAMES, played); // the wave does not need the older frames
+
+  float samples[SMOOTHED_AMPLITUDES_SIZE];
+  long numPoints = 0;
+  for (long i = available - 1; i >= 0 &&
+                               numPoints < SMOOTHED_AMPLITUDES_SIZE &&
+                               numPoints * dx < SCREEN_WIDTH;
+       i -= dx, ++numPoints) {
+    samples[numPoints] = recent[i];
+  }
 
-  if (!lockBuffer())
+  if (numPoints == 0)
     return;
+  const float waveSeconds = STATE->smoothing.wave;
+  envelopeApply(WAVE_ENVELOPE, samples, numPoints,
+                envelopeCoefficients(waveSeconds, waveSeconds, GetFrameTime()));
+  STATE->maxAmplitude = updateMaxAmplitude(
+      &WAVE_AUTO_GAIN, fmaxvf(WAVE_ENVELOPE, numPoints), GetTime());
 
-  const long dx = 2;
   int previous_h = -1;
-  for (long i = FRAME_BUFFER_SIZE - 1, j = 0, x = SCREEN_WIDTH - dx;
-       i >= 0 && j < SMOOTHED_AMPLITUDES_SIZE && x >= 0;
-       i -= dx, ++j, x -= dx) {
-
-    float sleft = FRAME_BUFFER[i].left;
-    const float smoothFactor = 1.2f;
-    SMOOTHED_AMPLITUDES[j] +=
-        (sleft - SMOOTHED_AMPLITUDES[j]) * smoothFactor * GetFrameTime();
-
-    sleft = SMOOTHED_AMPLITUDES[j];
-
-    STATE->maxAmplitude = max(STATE->maxAmplitude, sleft);
-    sleft /= STATE->maxAmplitude;
+  for (long j = 0, x = SCREEN_WIDTH - dx; j < numPoints; ++j, x -= dx) {
+    const float sleft = WAVE_ENVELOPE[j] / STATE->maxAmplitude;
 
     const bool reversed_rainbow = false;
     const Color color = nextRainbowColor(x, SCREEN_WIDTH, reversed_rainbow);
@@ -436,81 +1427,293 @@ static void drawWave(void) {
                color);
     previous_h = h;
   }
+}
 
-  unlockBuffer();
+static void drawDownmix(void) {
+  char label[32];
+  if (STATE->downmix == DOWNMIX_SIDE)
+    snprintf(label, sizeof(label), "SIDE");
+  else
+    snprintf(label, sizeof(label), "CHANNEL %zu OF %zu",
+             STATE->downmixChannel + 1, FRAMES.channels);
+  DrawText(label, SCREEN_WIDTH - 10 - MeasureText(label, 10), 50, 10, GRAY);
+}
+
+// Latency is the estimate plus the trim, A/V is how far the drawn audio is
+// ahead of what is heard (negative if the analysis lags behind).
+static void drawSync(void) {
+  char label[96];
+  snprintf(label, sizeof(label), "LATENCY %.0f MS (TRIM %+.0f)  A/V %+.1f MS",
+           1000.0 * PLAYBACK.latency, 1000.0f * STATE->syncTrimSeconds,
+           1000.0 * AV_OFFSET);
+  DrawText(label, 10, SCREEN_HEIGHT - 35, 10, GRAY);
+}
+
+static void drawCallTiming(const CallTiming *t, const char *name,
+                           const int y) {
+  const HistogramSummary interval = histogramSummary(&t->interval);
+  const HistogramSummary frames = histogramSummary(&t->frames);
+  const HistogramSummary busy = histogramSummary(&t->busy);
+  char label[160];
+  snprintf(label, sizeof(label),
+           "%s %.0f FRAMES EVERY %.1f MS (P99 %.1f, MAX %.1f)  BUSY P99 %.2f "
+           "MS  UNDERRUNS %" PRIu64,
+           name, frames.mean, interval.mean / 1000.0, interval.p99 / 1000.0,
+           interval.max / 1000.0, busy.p99 / 1000.0,
+           atomic_load_explicit(&t->underruns, memory_order_relaxed));
+  DrawText(label, 10, y, 10, GRAY);
+}
+
+static void drawTiming(void) {
+  drawCallTiming(&STATE->audioTiming, "CALLBACK", SCREEN_HEIGHT - 65);
+  drawCallTiming(&STATE->refillTiming, "REFILL", SCREEN_HEIGHT - 50);
+  for (size_t stage = 0; stage < STAGES; ++stage) {
+    char name[32];
+    snprintf(name, sizeof(name), "STAGE %s", STAGE_NAMES[stage]);
+    drawCallTiming(&STATE->stageTimings[stage], name,
+                   SCREEN_HEIGHT - 65 - 15 * (STAGES - stage));
+  }
+
+  const RingStats *c = &STATE->captureStats;
+  char label[192];
+  snprintf(label, sizeof(label),
+           "CAPTURED %" PRIu64 " FRAMES IN %" PRIu64
+           " CALLBACKS  DROPPED %" PRIu64 " FRAMES IN %" PRIu64
+           "  SKIPPED %" PRIu64 " HOPS  HELD %" PRIu64
+           " FRAMES  STAGES SKIPPED %" PRIu64 " FRAMES",
+           c->frames, c->writes, c->droppedFrames, c->droppedWrites,
+           STATE->skippedHops, STATE->heldFrames, STATE->skippedStageFrames);
+  DrawText(label, 10, SCREEN_HEIGHT - 65 - 15 * (STAGES + 1), 10, GRAY);
 }
 
 static void drawMusic(void) {
-  if (FRAME_BUFFER_SIZE == 0) {
+  if (framesWritten() == 0) {
     return; // Nothing to draw
   }
 
-  if (STATE->useWave) {
-    drawWave();
-  } else {
+  switch (STATE->displayMode) {
+  case DISPLAY_FREQUENCY:
     drawFrequency();
+    break;
+  case DISPLAY_WAVE:
+    drawWave();
+    break;
+  case DISPLAY_FILTERBANK:
+    drawFilterbank();
+    break;
+  case DISPLAY_MODE_COUNT:
+    assert(false && "Invalid display mode");
+  }
+  if (STATE->downmix != DOWNMIX_MID)
+    drawDownmix();
+  if (pcmIsOpen(&LIVE) && atomic_load(&LIVE.ended)) {
+    const char *label = "LIVE INPUT ENDED";
+    DrawText(label, SCREEN_WIDTH - 10 - MeasureText(label, 10), 65, 10, GRAY);
   }
 }
 
 // NOTE: From raudio.c:1269 (LoadMusicStream) of raylib:
 //  We are loading samples are 32bit float normalized data, so,
 //  we configure the output audio stream to also use float 32bit
+// The live input converts to the same format.
+// The frames are stamped with the time of the callback, so this stays on
+// the audio thread
+static void writeFrames(void *context, float samples[], size_t frames,
+                        double now) {
+  (void)context;
+  // Sequentially consistent, so that either this sees the hold or
+  // holdFrames sees this write
+  atomic_store(&FRAMES_WRITING, true);
+  if (atomic_load(&FRAMES_HELD)) {
+    atomic_fetch_add_explicit(&HELD_FRAMES, frames, memory_order_relaxed);
+  } else {
+    if (atomic_load_explicit(&PREROLL_PENDING, memory_order_acquire)) {
+      // A burst of its own, it was never at the device
+      const uint64_t start = ringWritten(&FRAMES);
+      ringWrite(&FRAMES, PREROLL, PREROLL_LENGTH,
+                now - 2 * RING_BURST_SECONDS);
+      atomic_store_explicit(&PREROLL_START, start, memory_order_relaxed);
+      atomic_store_explicit(&PREROLL_END, start + PREROLL_LENGTH,
+                            memory_order_relaxed);
+      atomic_fetch_add_explicit(&PREROLLS, 1, memory_order_release);
+      atomic_store_explicit(&PREROLL_PENDING, false, memory_order_release);
+    }
+    ringWrite(&FRAMES, samples, frames, now);
+  }
+  atomic_store_explicit(&FRAMES_WRITING, false, memory_order_release);
+}
+
+static void meterLoudness(void *context, float samples[], size_t frames,
+                          double now) {
+  (void)now;
+  loudnessProcess(context, samples, frames);
+}
+
+// Builds CHAIN for blocks of `channels` and starts its worker. Only while
+// nothing calls fillSampleBuffer.
+static void startChain(const size_t channels) {
+  chainFree(&CHAIN);
+  if (!chainInit(&CHAIN, channels, CHAIN_BLOCK_FRAMES, CHAIN_QUEUE_FRAMES))
+    exit(EXIT_FAILURE); // TODO: pass error to state
+  chainAdd(&CHAIN, STAGE_NAMES[STAGE_FRAMES], writeFrames, NULL, false,
+           &STATE->stageTimings[STAGE_FRAMES]);
+  chainAdd(&CHAIN, STAGE_NAMES[STAGE_LOUDNESS], meterLoudness, &LOUDNESS,
+           true, &STATE->stageTimings[STAGE_LOUDNESS]);
+#if !FOR_WASM
+  if (!chainStart(&CHAIN))
+    fprintf(stderr, "WARNING: The loudness is metered on the audio thread\n");
+#endif // FOR_WASM
+}
+
+static void stopChain(void) {
+  chainStop(&CHAIN);
+  for (size_t stage = 0; stage < STAGES; ++stage)
+    callTimingRestart(&STATE->stageTimings[stage]);
+}
+
 static void fillSampleBuffer(void *buffer, unsigned int frames) {
   if (frames == 0)
     return; // Nothing to do! TODO: Check if this even can happen.
-  assert(CHANNELS == 2 && "Does only support music with 2 channels.");
-  const float *samples = (float *)buffer;
-
-  const unsigned int available_frames_to_fill =
-      FRAME_BUFFER_CAPACITY - FRAME_BUFFER_SIZE;
-
-  if (!tryLockBuffer())
-    return;
+  if (!atomic_load_explicit(&SCHEDULED[SCHEDULED_AUDIO], memory_order_relaxed))
+    scheduleThread(SCHEDULED_AUDIO, pthread_self());
+  const uint64_t start = timingNow();
+
+  // Does not wait for the render thread either
+  chainProcess(&CHAIN, buffer, frames, monotonicSeconds());
+
+  const uint64_t interval =
+      callTimingRecord(&STATE->audioTiming, start, timingNow(), frames);
+  // The device ran dry if the callback came after the periods it had
+  // buffered were played. The live input is not paced by the device.
+  if (!pcmIsOpen(&LIVE) &&
+      interval * SAMPLE_RATE > AUDIO_DEVICE_PERIODS * frames * 1000000ull)
+    callTimingUnderrun(&STATE->audioTiming);
+}
 
-  if (frames <= available_frames_to_fill) {
-    memcpy(FRAME_BUFFER + FRAME_BUFFER_SIZE, samples,
-           frames *
-               sizeof(Frames)); // HACK: This only works for two channel audio
-                                //  because Frames contains 2 floats.
-    FRAME_BUFFER_SIZE += frames;
-  } else if (frames >= FRAME_BUFFER_CAPACITY) {
-    memcpy(FRAME_BUFFER, &samples[frames - FRAME_BUFFER_CAPACITY],
-           FRAME_BUFFER_CAPACITY *
-               sizeof(Frames)); // HACK: This only works for two channel audio
-                                //  because Frames contains 2 floats.
-    FRAME_BUFFER_SIZE = FRAME_BUFFER_CAPACITY;
-  } else {
-    assert(FRAME_BUFFER_CAPACITY < frames + FRAME_BUFFER_SIZE);
-    const unsigned int diff =
-        frames + FRAME_BUFFER_SIZE - FRAME_BUFFER_CAPACITY;
-    memmove(FRAME_BUFFER, &FRAME_BUFFER[diff],
-            (FRAME_BUFFER_SIZE - diff) *
-                sizeof(Frames)); // HACK: This only works for two channel audio
-                                 //  because Frames contains 2 floats.)
-    memcpy(&FRAME_BUFFER[FRAME_BUFFER_SIZE - diff], samples,
-           frames *
-               sizeof(Frames)); // HACK: This only works for two channel audio
-                                //  because Frames contains 2 floats.
-                                //  FRAME_BUFFER_SIZE = FRAME_BUFFER_CAPACITY;
-    FRAME_BUFFER_SIZE = FRAME_BUFFER_CAPACITY;
-  }
-  unlockBuffer();
+// Processors get the format of the device, not that of the stream: the
+// frames are converted to the device's sample rate and channels before
+// they are mixed. raylib only reports that format in its log, so it is read
+// from there while the device is initialized.
+typedef struct DeviceFormat {
+  unsigned int sampleRate;
+  unsigned int channels;
+} DeviceFormat;
+
+#define DEVICE_DEFAULT_RATE 48000
+#define DEVICE_DEFAULT_CHANNELS 2
+
+static DeviceFormat DEVICE = {0};
+
+static void readDeviceFormat(int logLevel, const char *text, va_list args) {
+  char line[256];
+  vsnprintf(line, sizeof(line), text, args);
+  unsigned int value;
+  if (sscanf(line, " > Sample rate: %u", &value) == 1)
+    DEVICE.sampleRate = value;
+  else if (sscanf(line, " > Channels: %u", &value) == 1)
+    DEVICE.channels = value;
+
+  // Printed like raylib does it
+  static const char *prefixes[] = {
+      [LOG_TRACE] = "TRACE: ", [LOG_DEBUG] = "DEBUG: ",
+      [LOG_INFO] = "INFO: ",   [LOG_WARNING] = "WARNING: ",
+      [LOG_ERROR] = "ERROR: ", [LOG_FATAL] = "FATAL: ",
+  };
+  const bool known = logLevel >= LOG_TRACE && logLevel <= LOG_FATAL;
+  printf("%s%s\n", known ? prefixes[logLevel] : "", line);
 }
 
 static bool initInternal(void) {
-
-  if (pthread_mutex_init(&BUFFER_LOCK, NULL) != 0) {
-    printf("\n mutex init failed\n");
-    return false;
-  }
   SetConfigFlags(FLAG_MSAA_4X_HINT); // Enable anti-aliasing
   InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "musializer");
+  DEVICE = (DeviceFormat){DEVICE_DEFAULT_RATE, DEVICE_DEFAULT_CHANNELS};
+  SetTraceLogCallback(readDeviceFormat);
   InitAudioDevice();
+  SetTraceLogCallback(NULL);
+  printf("Audio device: %u Hz, %u channels\n", DEVICE.sampleRate,
+         DEVICE.channels);
 
   SetTargetFPS(FPS); // Set our game to run at 30 frames-per-second
   return true;
 }
 
+#if !FOR_WASM
+// Leaves the input disabled if MUSIALIZER_PCM is not set or a setting is
+// invalid
+static void liveInputFromEnvironment(LiveInput *live) {
+  const char *path = getenv("MUSIALIZER_PCM");
+  if (path == NULL || *path == '\0')
+    return;
+  const char *format = getenv("MUSIALIZER_PCM_FORMAT");
+  const char *rate = getenv("MUSIALIZER_PCM_RATE");
+  const char *channels = getenv("MUSIALIZER_PCM_CHANNELS");
+  *live = (LiveInput){
+      .path = path,
+      .format = PCM_S16,
+      .sampleRate = rate != NULL ? strtoul(rate, NULL, 10) : LIVE_DEFAULT_RATE,
+      .channels = channels != NULL ? strtoul(channels, NULL, 10)
+                                   : LIVE_DEFAULT_CHANNELS,
+  };
+  live->enabled = format == NULL || pcmParseFormat(format, &live->format);
+}
+#endif // FOR_WASM
+
+// A power of two between ANALYSIS_MIN_WINDOW and ANALYSIS_MAX_WINDOW
+static unsigned int analysisWindowFromEnvironment(void) {
+  const char *frames = getenv("MUSIALIZER_ANALYSIS_WINDOW");
+  if (frames == NULL)
+    return ANALYSIS_DEFAULT_WINDOW;
+  const unsigned long window = strtoul(frames, NULL, 10);
+  if (window < ANALYSIS_MIN_WINDOW || window > ANALYSIS_MAX_WINDOW ||
+      (window & (window - 1)) != 0) {
+    fprintf(stderr,
+            "WARNING: MUSIALIZER_ANALYSIS_WINDOW must be a power of two from "
+            "%d to %d, using %d\n",
+            ANALYSIS_MIN_WINDOW, ANALYSIS_MAX_WINDOW, ANALYSIS_DEFAULT_WINDOW);
+    return ANALYSIS_DEFAULT_WINDOW;
+  }
+  return window;
+}
+
+// 1, 2 or 4
+static unsigned int zeroPadFromEnvironment(void) {
+  const char *factor = getenv("MUSIALIZER_ZERO_PAD");
+  if (factor == NULL)
+    return ANALYSIS_DEFAULT_ZERO_PAD;
+  const unsigned long zeroPad = strtoul(factor, NULL, 10);
+  if (zeroPad < 1 || zeroPad > ANALYSIS_MAX_ZERO_PAD ||
+      (zeroPad & (zeroPad - 1)) != 0) {
+    fprintf(stderr,
+            "WARNING: MUSIALIZER_ZERO_PAD must be 1, 2 or 4, using %d\n",
+            ANALYSIS_DEFAULT_ZERO_PAD);
+    return ANALYSIS_DEFAULT_ZERO_PAD;
+  }
+  return zeroPad;
+}
+
+#if !FOR_WASM
+static void schedulesFromEnvironment(ThreadSchedule schedules[]) {
+  for (size_t t = 0; t < SCHEDULED_THREADS; ++t) {
+    schedules[t] = (ThreadSchedule){.policy = REALTIME_KEEP};
+    const char *spec = getenv(SCHEDULED_VARIABLES[t]);
+    if (spec != NULL && !realtimeParse(spec, &schedules[t]))
+      fprintf(stderr,
+              "WARNING: %s must look like fifo:80, rr:50@2,3, other or @1, "
+              "leaving the thread as it is\n",
+              SCHEDULED_VARIABLES[t]);
+  }
+}
+#endif // FOR_WASM
+
+static float decodeAheadFromEnvironment(void) {
+  const char *ms = getenv("MUSIALIZER_DECODE_AHEAD_MS");
+  if (ms == NULL)
+    return DECODE_AHEAD_DEFAULT_SECONDS;
+  const float seconds = strtof(ms, NULL) / 1000.0f;
+  return seconds > DECODE_AHEAD_MIN_SECONDS ? seconds
+                                            : DECODE_AHEAD_MIN_SECONDS;
+}
+
 bool init(void) {
 
   if (!initInternal()) {
@@ -524,41 +1727,481 @@ bool init(void) {
   STATE->reload = false;
   STATE->timePlayedSeconds = 0.0f;
   STATE->maxAmplitude = DEFAULT_MAX_AMPLITUDE;
+  STATE->analysisHop = ANALYSIS_DEFAULT_HOP;
+  STATE->analysisWindow = analysisWindowFromEnvironment();
+  STATE->zeroPad = zeroPadFromEnvironment();
+  STATE->autoGainWindowSeconds = AUTO_GAIN_DEFAULT_WINDOW;
+  STATE->autoGainDecaySeconds = AUTO_GAIN_DEFAULT_DECAY;
+  STATE->smoothing = DEFAULT_SMOOTHING_TIMES;
+  STATE->beat = (BeatInfo){0};
+  STATE->showChroma = false;
+  STATE->suppressHarmonics = true;
+  for (int c = 0; c < CHROMA_PITCH_CLASSES; ++c)
+    STATE->chroma[c] = 0.0f;
+  STATE->key = 0;
+  STATE->keyMinor = false;
+  STATE->showLoudness = false;
+  STATE->showSync = false;
+  STATE->syncTrimSeconds = 0.0f;
+  STATE->features = (SpectralFeatures){0};
+  STATE->showFeatures = false;
 
 #if FOR_WASM
   STATE->windowPosition = (Vector2){0, 0};
 #else
   STATE->windowPosition = GetWindowPosition();
 #endif
-  STATE->useWave = false;
+  STATE->displayMode = DISPLAY_FREQUENCY;
+  STATE->resolution = RESOLUTION_FULL;
+  STATE->downmix = DOWNMIX_MID;
+  STATE->downmixChannel = 0;
+  STATE->filterbank = (FilterbankConfig){
+      .scale = FILTERBANK_MEL,
+      .bands = FILTERBANK_DEFAULT_BANDS,
+      .minHz = FILTERBANK_MIN_HZ,
+      .maxHz = FILTERBANK_MAX_HZ,
+  };
   STATE->musicFiles = (MusicFiles){0, 0, NULL};
+  STATE->liveInput = (LiveInput){0};
+  STATE->decodeAheadSeconds = decodeAheadFromEnvironment();
+  STATE->crossfadeSeconds = 0.0f;
+  STATE->showTiming = false;
+  callTimingReset(&STATE->audioTiming);
+  callTimingReset(&STATE->refillTiming);
+  for (size_t stage = 0; stage < STAGES; ++stage)
+    callTimingReset(&STATE->stageTimings[stage]);
+  for (size_t t = 0; t < SCHEDULED_THREADS; ++t)
+    STATE->schedules[t] = (ThreadSchedule){.policy = REALTIME_KEEP};
+  STATE->captureStats = (RingStats){0};
+  STATE->skippedHops = 0;
+  STATE->heldFrames = 0;
+  STATE->skippedStageFrames = 0;
+#if !FOR_WASM
+  liveInputFromEnvironment(&STATE->liveInput);
+  schedulesFromEnvironment(STATE->schedules);
+#endif
   STATE->showHelp = false;
   STATE->showHelpInfo = false;
 
   return true;
 }
 
+// The next track of the playlist takes over on the audio thread, as
+// exactly as a device period allows. followTrack, a processor on MUSIC,
+// counts the frames it plays and starts NEXT_MUSIC in the period in which
+// MUSIC ends, or the crossfade before that with equal power gains. What is
+// left of MUSIC in that period fades out over the start of NEXT_MUSIC, and
+// everything after its end is silenced: it loops, because raylib drops the
+// last buffer of a stream that does not. update() swaps the streams after
+// the end without touching the ring, which is fed by the mixed processor,
+// so the analysis goes on across the boundary.
+//
+// The render thread only changes the counters below while followTrack is
+// detached, except for NEXT_READY.
+typedef enum Handover {
+  HANDOVER_WAITING, // for the crossfade or the end
+  HANDOVER_FADING,  // NEXT_MUSIC plays too
+  HANDOVER_DONE,    // MUSIC ended
+} Handover;
+
+static Music NEXT_MUSIC = {0};
+static size_t NEXT_INDEX = 0;
+static bool NEXT_QUEUED = false;        // render thread
+static _Atomic bool NEXT_READY = false; // NEXT_MUSIC may be started
+static _Atomic int HANDOVER = HANDOVER_WAITING;
+static uint64_t TRACK_FRAMES = 0; // device frames of MUSIC
+static uint64_t TRACK_PLAYED = 0;
+static uint64_t FADE_FRAMES = 0;
+static uint64_t NEXT_PLAYED = 0; // device frames of NEXT_MUSIC
+// A starved stream is still processed, as silence, but its position stands
+// still. Every run of such periods is an underrun of the refills.
+static float FOLLOWED_POSITION = -1.0f; // seconds
+static bool STARVED = false;
+static float REFILLED_POSITION = 0.0f; // by refillMusic
+
+static void followTrack(void *buffer, unsigned int frames) {
+  float *samples = buffer;
+  const size_t channels = DEVICE.channels;
+  const uint64_t played = TRACK_PLAYED;
+  TRACK_PLAYED += frames;
+  int handover = atomic_load_explicit(&HANDOVER, memory_order_relaxed);
+  if (handover == HANDOVER_DONE) {
+    memset(samples, 0, frames * channels * sizeof(float));
+    return;
+  }
+
+  const float position = GetMusicTimePlayed(MUSIC);
+  if (position == FOLLOWED_POSITION && !STARVED)
+    callTimingUnderrun(&STATE->refillTiming);
+  STARVED = position == FOLLOWED_POSITION;
+  FOLLOWED_POSITION = position;
+
+  const uint64_t end = TRACK_FRAMES;
+  if (handover == HANDOVER_WAITING && played + frames + FADE_FRAMES >= end &&
+      atomic_load_explicit(&NEXT_READY, memory_order_acquire)) {
+    SetMusicVolume(NEXT_MUSIC, FADE_FRAMES > 0 ? 0.0f : 1.0f);
+    PlayMusicStream(NEXT_MUSIC);
+    handover = HANDOVER_FADING;
+  }
+  if (handover == HANDOVER_FADING && FADE_FRAMES > 0) {
+    const uint64_t left = played < end ? end - played : 0;
+    const float t = left < FADE_FRAMES ? 1.0f - (float)left / FADE_FRAMES : 0;
+    SetMusicVolume(MUSIC, cosf(t * M_PI / 2.0f));
+    SetMusicVolume(NEXT_MUSIC, sinf(t * M_PI / 2.0f));
+  }
+
+  if (played + frames >= end) {
+    const uint64_t left = played < end ? end - played : 0;
+    for (uint64_t i = 0; i < left; ++i)
+      for (size_t c = 0; c < channels; ++c)
+        samples[i * channels + c] *= 1.0f - (float)i / left;
+    memset(&samples[left * channels], 0,
+           (frames - left) * channels * sizeof(float));
+    handover = HANDOVER_DONE;
+  }
+  atomic_store_explicit(&HANDOVER, handover, memory_order_relaxed);
+}
+
+static void countNext(void *buffer, unsigned int frames) {
+  (void)buffer;
+  NEXT_PLAYED += frames;
+}
+
+// Starts following MUSIC, which is `playedSeconds` in
+static void followMusic(const float playedSeconds) {
+  const float length = GetMusicTimeLength(MUSIC);
+  const float fade = STATE->crossfadeSeconds < length / 2.0f
+                         ? STATE->crossfadeSeconds
+                         : length / 2.0f;
+  TRACK_FRAMES = length * DEVICE.sampleRate;
+  TRACK_PLAYED = playedSeconds * DEVICE.sampleRate;
+  FADE_FRAMES = fade * DEVICE.sampleRate;
+  FOLLOWED_POSITION = -1.0f;
+  STARVED = false;
+  REFILLED_POSITION = playedSeconds;
+  atomic_store_explicit(&HANDOVER, HANDOVER_WAITING, memory_order_relaxed);
+  SetMusicVolume(MUSIC, 1.0f);
+  AttachAudioStreamProcessor(MUSIC.stream, followTrack);
+}
+
+// Before MUSIC stops, pauses or seeks. A transition that began is undone.
+static void unfollowMusic(void) {
+  DetachAudioStreamProcessor(MUSIC.stream, followTrack);
+  if (atomic_load_explicit(&HANDOVER, memory_order_relaxed) !=
+          HANDOVER_WAITING &&
+      atomic_load_explicit(&NEXT_READY, memory_order_relaxed)) {
+    StopMusicStream(NEXT_MUSIC); // back to its start
+    NEXT_PLAYED = 0;
+  }
+}
+
+// Seeks MUSIC and decodes what comes before the target into PREROLL, for
+// fillSampleBuffer. What raylib decoded ahead of the old position is
+// dropped, so that the target plays right after the pre-roll in the ring.
+// With MUSIC_LOCK held or the decoder stopped.
+static void seekMusic(float seconds) {
+  const float length = GetMusicTimeLength(MUSIC);
+  seconds = seconds < 0.0f ? 0.0f : (seconds > length ? length : seconds);
+  const bool playing = IsMusicStreamPlaying(MUSIC);
+  unfollowMusic();
+  StopAudioStream(MUSIC.stream); // unlike StopMusicStream keeps the decoder
+  // Paused, the target would not follow the pre-roll
+  const bool preroll =
+      playing && !atomic_load_explicit(&PREROLL_PENDING, memory_order_acquire);
+  if (preroll) {
+    PREROLL_LENGTH = prerollDecode(MUSIC, seconds, PREROLL, PREROLL_CAPACITY,
+                                   DEVICE.sampleRate, DEVICE.channels);
+  } else {
+    SeekMusicStream(MUSIC, seconds);
+  }
+  UpdateMusicStream(MUSIC);
+  // As late as possible, so that no callback comes in between
+  if (preroll && PREROLL_LENGTH > 0)
+    atomic_store_explicit(&PREROLL_PENDING, true, memory_order_release);
+  PlayMusicStream(MUSIC);
+  if (playing)
+    followMusic(seconds);
+  else
+    PauseMusicStream(MUSIC);
+}
+
+// The decoder thread refills the music streams, so neither a slow frame nor
+// a stall of the render loop (a file drop, a hot reload) starves the
+// device. raylib's music functions are not thread-safe, so every call on
+// the streams outside of the decoder takes MUSIC_LOCK, except for those of
+// followTrack, which only starts a stream and sets volumes. Without threads
+// (the web build) update() refills the streams itself.
+static pthread_mutex_t MUSIC_LOCK = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t DECODER_THREAD;
+static bool DECODER_THREADED = false;
+static _Atomic bool DECODER_RUNNING = false;
+
+#define DECODER_MIN_SLEEP_MICROSECONDS 1000
+#define DECODER_MAX_SLEEP_MICROSECONDS 10000
+
+// Refills the streams and times the refills of MUSIC, with the frames it
+// played since the previous one as their size. With MUSIC_LOCK held.
+static void refillMusic(void) {
+  const bool refill = IsAudioStreamProcessed(MUSIC.stream);
+  const uint64_t start = timingNow();
+  UpdateMusicStream(MUSIC);
+  if (refill) {
+    const uint64_t end = timingNow();
+    const float position = GetMusicTimePlayed(MUSIC);
+    const float played = position > REFILLED_POSITION
+                             ? position - REFILLED_POSITION
+                             : 0.0f; // it looped or was seeked back
+    REFILLED_POSITION = position;
+    callTimingRecord(&STATE->refillTiming, start, end,
+                     played * MUSIC.stream.sampleRate);
+  }
+  if (atomic_load_explicit(&NEXT_READY, memory_order_relaxed))
+    UpdateMusicStream(NEXT_MUSIC);
+}
+
+#if !FOR_WASM
+static void *decodeMusic(void *arg) {
+  (void)arg;
+  // A few polls per half of the buffer
+  long us = 1e6 * STATE->decodeAheadSeconds / 8;
+  us = us < DECODER_MIN_SLEEP_MICROSECONDS   ? DECODER_MIN_SLEEP_MICROSECONDS
+       : us > DECODER_MAX_SLEEP_MICROSECONDS ? DECODER_MAX_SLEEP_MICROSECONDS
+                                             : us;
+  const struct timespec idle = {.tv_sec = 0, .tv_nsec = us * 1000};
+  while (atomic_load_explicit(&DECODER_RUNNING, memory_order_acquire)) {
+    pthread_mutex_lock(&MUSIC_LOCK);
+    refillMusic();
+    pthread_mutex_unlock(&MUSIC_LOCK);
+    nanosleep(&idle, NULL);
+  }
+  return NULL;
+}
+#endif // FOR_WASM
+
+static void startDecoder(void) {
+  DECODER_THREADED = false;
+#if !FOR_WASM
+  atomic_store_explicit(&DECODER_RUNNING, true, memory_order_release);
+  unscheduleThread(SCHEDULED_DECODER);
+  const int err = pthread_create(&DECODER_THREAD, NULL, decodeMusic, NULL);
+  if (err == 0) {
+    DECODER_THREADED = true;
+    scheduleThread(SCHEDULED_DECODER, DECODER_THREAD);
+  } else
+    fprintf(stderr, "WARNING: Decoding runs on the render thread: %s\n",
+            strerror(err));
+#endif
+}
+
+static void stopDecoder(void) {
+  if (!DECODER_THREADED)
+    return;
+  atomic_store_explicit(&DECODER_RUNNING, false, memory_order_release);
+  pthread_join(DECODER_THREAD, NULL);
+  DECODER_THREADED = false;
+}
+
+// The next track of the playlist is loaded (opened, probed, and its stream
+// buffer decoded) on a thread while the current one plays, so that
+// startMusic can switch to it without touching the disk.
+static pthread_t PREFETCH_THREAD;
+static bool PREFETCHING = false;
+static size_t PREFETCH_INDEX = 0;
+static Music PREFETCHED = {0};
+static _Atomic bool PREFETCH_DONE = false; // the join will not wait
+
+#if !FOR_WASM
+static void *prefetchMusic(void *arg) {
+  const char *path = arg;
+  const Music music = LoadMusicStream(path);
+  if (IsMusicReady(music)) {
+    pthread_mutex_lock(&MUSIC_LOCK); // raylib decodes into a shared buffer
+    UpdateMusicStream(music);
+    pthread_mutex_unlock(&MUSIC_LOCK);
+  }
+  PREFETCHED = music; // read after the join
+  atomic_store_explicit(&PREFETCH_DONE, true, memory_order_release);
+  return NULL;
+}
+#endif // FOR_WASM
+
+static void startPrefetch(const size_t index) {
+#if !FOR_WASM
+  PREFETCH_INDEX = index;
+  PREFETCHED = (Music){0};
+  atomic_store_explicit(&PREFETCH_DONE, false, memory_order_relaxed);
+  const int err = pthread_create(&PREFETCH_THREAD, NULL, prefetchMusic,
+                                 STATE->musicFiles.paths[index]);
+  PREFETCHING = err == 0;
+  if (err != 0)
+    fprintf(stderr, "WARNING: Could not prefetch the next track: %s\n",
+            strerror(err));
+#else
+  (void)index;
+#endif
+}
+
+// Waits for the prefetch and returns its music if it is the track at
+// `index`, otherwise unloads it and returns an unready music.
+static Music takePrefetched(const size_t index) {
+  if (!PREFETCHING)
+    return (Music){0};
+  pthread_join(PREFETCH_THREAD, NULL);
+  PREFETCHING = false;
+  const Music music = PREFETCHED;
+  PREFETCHED = (Music){0};
+  if (PREFETCH_INDEX != index && IsMusicReady(music)) {
+    UnloadMusicStream(music);
+    return (Music){0};
+  }
+  return music;
+}
+
+// Before the playlist changes
+static void discardPrefetch(void) { takePrefetched(SIZE_MAX); }
+
+static size_t nextIndex(void) {
+  return (STATE->musicFiles.currentlyPlayed + 1) % STATE->musicFiles.count;
+}
+
+// Hands the track after MUSIC to followTrack, from the prefetch or, if
+// there is none, loaded right away
+static void queueNext(void) {
+  NEXT_QUEUED = true;
+  const size_t index = nextIndex();
+  Music music = takePrefetched(index);
+  if (!IsMusicReady(music))
+    music = LoadMusicStream(STATE->musicFiles.paths[index]);
+  if (!IsMusicReady(music))
+    return;
+  pthread_mutex_lock(&MUSIC_LOCK);
+  NEXT_MUSIC = music;
+  NEXT_INDEX = index;
+  NEXT_PLAYED = 0;
+  AttachAudioStreamProcessor(NEXT_MUSIC.stream, countNext);
+  atomic_store_explicit(&NEXT_READY, true, memory_order_release);
+  pthread_mutex_unlock(&MUSIC_LOCK);
+}
+
+static void unloadNext(void) {
+  NEXT_QUEUED = false;
+  if (!atomic_load_explicit(&NEXT_READY, memory_order_relaxed))
+    return;
+  atomic_store_explicit(&NEXT_READY, false, memory_order_relaxed);
+  DetachAudioStreamProcessor(NEXT_MUSIC.stream, countNext);
+  StopMusicStream(NEXT_MUSIC);
+  UnloadMusicStream(NEXT_MUSIC);
+  NEXT_MUSIC = (Music){0};
+}
+
+// Frames of the frame buffer and of the pre-roll for the analysis window
+static size_t prerollCapacity(void) {
+  return STATE->analysisWindow + PREROLL_WARM_FRAMES;
+}
+
+// A power of two that also holds a whole pre-roll and the window after it,
+// so that the warm-up never sees a window cut short by the ring
+static size_t frameBufferCapacity(void) {
+  size_t capacity = (size_t)FRAME_BUFFER_WINDOWS * STATE->analysisWindow;
+  while (capacity < prerollCapacity() + STATE->analysisWindow)
+    capacity *= 2;
+  return capacity;
+}
+
+// Sizes FRAMES for `channels` and PREROLL for the device, both empty. Only
+// while nothing writes or reads them.
+static void initFrames(const size_t channels) {
+  const size_t capacity = frameBufferCapacity();
+  const size_t kept = channels < RING_MAX_CHANNELS ? channels
+                                                   : RING_MAX_CHANNELS;
+  free(FRAME_BUFFER);
+  FRAME_BUFFER = malloc(capacity * kept * sizeof(float));
+  free(PREROLL);
+  PREROLL_CAPACITY = prerollCapacity();
+  PREROLL = malloc(PREROLL_CAPACITY * DEVICE.channels * sizeof(float));
+  if (FRAME_BUFFER == NULL || PREROLL == NULL ||
+      !ringInit(&FRAMES, FRAME_BUFFER, capacity, channels))
+    exit(EXIT_FAILURE); // TODO: pass error to state
+  atomic_store_explicit(&HELD_FRAMES, 0, memory_order_relaxed);
+}
+
+static void freeFrames(void) {
+  free(FRAME_BUFFER);
+  FRAME_BUFFER = NULL;
+  free(PREROLL);
+  PREROLL = NULL;
+  PREROLL_CAPACITY = 0;
+}
+
+// Keeps fillSampleBuffer away from FRAMES and PREROLL until releaseFrames,
+// after the write it may be in the middle of
+static void holdFrames(void) {
+  atomic_store(&FRAMES_HELD, true);
+  while (atomic_load(&FRAMES_WRITING))
+    ; // one ring write, microseconds
+}
+
+static void releaseFrames(void) {
+  atomic_store_explicit(&FRAMES_HELD, false, memory_order_release);
+}
+
+static void startLiveInput(void) {
+  const LiveInput *live = &STATE->liveInput;
+  initFrames(live->channels);
+  if (STATE->downmixChannel >= FRAMES.channels)
+    STATE->downmixChannel = 0;
+  SAMPLE_RATE = live->sampleRate;
+  loudnessInit(&LOUDNESS, live->sampleRate, live->channels);
+  startChain(live->channels);
+  unscheduleThread(SCHEDULED_AUDIO);
+  if (!pcmOpen(&LIVE, live->path, live->format, live->sampleRate,
+               live->channels, fillSampleBuffer)) {
+    STATE->liveInput.enabled = false;
+    return;
+  }
+  printf("Live input: %s\n", live->path);
+  printf("Sample rate: %u\n", live->sampleRate);
+  printf("Channels: %u\n", live->channels);
+  resetFilter();
+  startAnalysis();
+}
+
 static void startMusic(void) {
   STATE->maxAmplitude =
       DEFAULT_MAX_AMPLITUDE; // Start as if they are normalized
 
-  if (!lockBuffer()) {
-    exit(EXIT_FAILURE); // TODO: pass error to state
-  }
-  FRAME_BUFFER_SIZE = 0;
-  unlockBuffer();
+  // The callback is detached, so the ring has no producer right now
+  ringReset(&FRAMES);
 
   if (STATE->musicFiles.count > 0) {
-    MUSIC = LoadMusicStream(
-        STATE->musicFiles.paths[STATE->musicFiles.currentlyPlayed]);
-    CHANNELS = MUSIC.stream.channels;
+    const size_t current = STATE->musicFiles.currentlyPlayed;
+    SetAudioStreamBufferSizeDefault(STATE->decodeAheadSeconds *
+                                    DECODE_AHEAD_NOMINAL_RATE / 2);
+    MUSIC = takePrefetched(current);
+    if (!IsMusicReady(MUSIC))
+      MUSIC = LoadMusicStream(STATE->musicFiles.paths[current]);
+    // The mixed output is analyzed, so that one track runs into the next
+    initFrames(DEVICE.channels);
+    if (STATE->downmixChannel >= FRAMES.channels)
+      STATE->downmixChannel = 0;
     printf("Frame count: %u\n", MUSIC.frameCount);
     printf("Sample rate: %u\n", MUSIC.stream.sampleRate);
     printf("Frame size: %u\n", MUSIC.frameCount);
+    SAMPLE_RATE = DEVICE.sampleRate;
+    loudnessInit(&LOUDNESS, DEVICE.sampleRate, DEVICE.channels);
+    startChain(DEVICE.channels);
+    unscheduleThread(SCHEDULED_AUDIO);
+    AttachAudioMixedProcessor(fillSampleBuffer);
     PlayMusicStream(MUSIC);
-    SeekMusicStream(MUSIC, STATE->timePlayedSeconds);
-    AttachAudioStreamProcessor(MUSIC.stream, fillSampleBuffer);
+    followMusic(0.0f);
+    if (STATE->timePlayedSeconds > 0.0f) // keeps what was prefetched
+      seekMusic(STATE->timePlayedSeconds);
     resetFilter();
+    startAnalysis();
+    startDecoder();
+    startPrefetch(nextIndex());
+  } else if (STATE->liveInput.enabled) {
+    startLiveInput();
   }
 }
 
@@ -582,24 +2225,179 @@ State *getState(void) { return STATE; }
 
 bool finished(void) { return STATE->finished; }
 
+// Every block of the callback goes into the ring, so frames only get lost
+// if the analysis falls so far behind that the ring overwrites them.
+static void refreshCaptureStats(void) {
+  STATE->captureStats = ringStats(&FRAMES);
+  STATE->skippedHops =
+      atomic_load_explicit(&SKIPPED_HOPS, memory_order_relaxed);
+  STATE->heldFrames = atomic_load_explicit(&HELD_FRAMES, memory_order_relaxed);
+  STATE->skippedStageFrames = chainSkippedFrames(&CHAIN);
+}
+
+static void printCaptureStats(void) {
+  refreshCaptureStats();
+  const RingStats *stats = &STATE->captureStats;
+  printf("Captured %" PRIu64 " frames in %" PRIu64 " callbacks\n",
+         stats->frames, stats->writes);
+  printf("Dropped %" PRIu64 " frames in %" PRIu64
+         " callbacks, skipped %" PRIu64 " hops\n",
+         stats->droppedFrames, stats->droppedWrites, STATE->skippedHops);
+  if (STATE->heldFrames > 0)
+    printf("Lost %" PRIu64 " frames while the frame buffer was resized\n",
+           STATE->heldFrames);
+  if (STATE->skippedStageFrames > 0)
+    printf("The stages off the audio thread skipped %" PRIu64 " frames\n",
+           STATE->skippedStageFrames);
+}
+
 static void stopMusic(void) {
   if (IsMusicReady(MUSIC)) {
-    DetachAudioStreamProcessor(MUSIC.stream, fillSampleBuffer);
+    stopDecoder();
+    stopAnalysis();
+    DetachAudioMixedProcessor(fillSampleBuffer);
+    stopChain();
+    atomic_store_explicit(&PREROLL_PENDING, false, memory_order_relaxed);
+    callTimingRestart(&STATE->audioTiming);
+    callTimingRestart(&STATE->refillTiming);
+    printCaptureStats();
+    unfollowMusic();
+    unloadNext();
     StopMusicStream(MUSIC);
     UnloadMusicStream(MUSIC);
     MUSIC = (Music){0};
   }
+  if (pcmIsOpen(&LIVE)) {
+    stopAnalysis();
+    pcmClose(&LIVE);
+    stopChain();
+    callTimingRestart(&STATE->audioTiming);
+    printCaptureStats();
+  }
+}
+
+static bool inputReady(void) { return IsMusicReady(MUSIC) || pcmIsOpen(&LIVE); }
+
+// Applies the analysis window of STATE while the input plays: FRAMES and
+// PREROLL move to buffers of the new size with the frames they hold, and the
+// analysis rebuilds its FFT state when it sees the new config.
+static void resizeAnalysisWindow(void) {
+  printf("Analysis window: %u frames, FFT %u\n", STATE->analysisWindow,
+         STATE->analysisWindow * STATE->zeroPad);
+  if (!inputReady())
+    return; // the next start sizes the buffers
+
+  const size_t capacity = frameBufferCapacity();
+  const size_t prerollFrames = prerollCapacity();
+  float *samples = malloc(capacity * FRAMES.channels * sizeof(float));
+  float *preroll = malloc(prerollFrames * DEVICE.channels * sizeof(float));
+  if (samples == NULL || preroll == NULL) {
+    fprintf(stderr, "Could not allocate the frame buffer\n");
+    free(samples);
+    free(preroll);
+    return; // the analysis makes do with shorter windows
+  }
+
+  stopAnalysis();
+  holdFrames();
+  ringMove(&FRAMES, samples, capacity);
+  if (atomic_load_explicit(&PREROLL_PENDING, memory_order_relaxed)) {
+    // Its end is right before the seek target
+    const size_t kept =
+        PREROLL_LENGTH < prerollFrames ? PREROLL_LENGTH : prerollFrames;
+    memcpy(preroll, &PREROLL[(PREROLL_LENGTH - kept) * DEVICE.channels],
+           kept * DEVICE.channels * sizeof(float));
+    PREROLL_LENGTH = kept;
+  }
+  float *oldSamples = FRAME_BUFFER;
+  float *oldPreroll = PREROLL;
+  FRAME_BUFFER = samples;
+  PREROLL = preroll;
+  PREROLL_CAPACITY = prerollFrames;
+  releaseFrames();
+  free(oldSamples);
+  free(oldPreroll);
+
+  publishAnalysisConfig();
+  runAnalysis();
+}
+
+// After followTrack saw the end of MUSIC. NEXT_MUSIC already plays, unless
+// it could not be loaded in time.
+static void nextTrack(void) {
+  if (!NEXT_QUEUED)
+    queueNext();
+  STATE->musicFiles.currentlyPlayed = nextIndex();
+  STATE->timePlayedSeconds = 0.0f;
+  if (!atomic_load_explicit(&NEXT_READY, memory_order_relaxed) ||
+      NEXT_INDEX != STATE->musicFiles.currentlyPlayed) {
+    stopMusic();
+    startMusic();
+    return;
+  }
+
+  pthread_mutex_lock(&MUSIC_LOCK);
+  DetachAudioStreamProcessor(MUSIC.stream, followTrack);
+  DetachAudioStreamProcessor(NEXT_MUSIC.stream, countNext);
+  StopMusicStream(MUSIC);
+  UnloadMusicStream(MUSIC);
+  MUSIC = NEXT_MUSIC;
+  NEXT_MUSIC = (Music){0};
+  atomic_store_explicit(&NEXT_READY, false, memory_order_relaxed);
+  NEXT_QUEUED = false;
+  if (!IsMusicStreamPlaying(MUSIC))
+    PlayMusicStream(MUSIC);
+  followMusic((float)NEXT_PLAYED / DEVICE.sampleRate);
+  pthread_mutex_unlock(&MUSIC_LOCK);
+  startPrefetch(nextIndex());
 }
 
 static void terminateInternal(void) {
   stopMusic();
+  discardPrefetch();
+  filterbankFree(&FILTERBANK);
+  descriptorsFree(&DESCRIPTORS);
+  analysisBuffersFree(&BUFFERS);
+  freeFrames();
+  chainFree(&CHAIN);
   CloseAudioDevice();
   CloseWindow();
-  pthread_mutex_destroy(&BUFFER_LOCK);
 }
 
+#if !FOR_WASM
+// The timings of the whole session, to MUSIALIZER_TIMING_FILE or
+// TIMING_DEFAULT_FILE
+static void dumpTiming(void) {
+  if (histogramSummary(&STATE->audioTiming.frames).count == 0)
+    return; // Nothing was played
+  const char *path = getenv("MUSIALIZER_TIMING_FILE");
+  if (path == NULL || *path == '\0')
+    path = TIMING_DEFAULT_FILE;
+  FILE *out = fopen(path, "w");
+  if (out == NULL) {
+    fprintf(stderr, "Could not write the timings to %s: %s\n", path,
+            strerror(errno));
+    return;
+  }
+  fprintf(out, "Device: %u Hz, %u channels, %d periods\n", DEVICE.sampleRate,
+          DEVICE.channels, AUDIO_DEVICE_PERIODS);
+  callTimingPrint(&STATE->audioTiming, out, "Audio callback");
+  callTimingPrint(&STATE->refillTiming, out, "Music refill");
+  for (size_t stage = 0; stage < STAGES; ++stage) {
+    char name[32];
+    snprintf(name, sizeof(name), "Stage %s", STAGE_NAMES[stage]);
+    callTimingPrint(&STATE->stageTimings[stage], out, name);
+  }
+  fclose(out);
+  printf("Timings written to %s\n", path);
+}
+#endif // FOR_WASM
+
 void terminate(void) {
   terminateInternal();
+#if !FOR_WASM
+  dumpTiming();
+#endif
 
   unloadMusicFiles();
   free(STATE);
@@ -620,6 +2418,10 @@ void update(void) {
     return;
   }
 
+  reportSchedules();
+  if (inputReady())
+    refreshCaptureStats();
+
 #if !FOR_WASM
   if (IsKeyPressed(KEY_Q)) {
     // Quit
@@ -642,60 +2444,162 @@ void update(void) {
   }
 
   if (IsKeyPressed(KEY_W)) {
-    STATE->useWave = !STATE->useWave;
+    STATE->displayMode = (STATE->displayMode + 1) % DISPLAY_MODE_COUNT;
     resetFilter();
   }
 
+  if (IsKeyPressed(KEY_LEFT_BRACKET) &&
+      STATE->analysisHop / 2 >= ANALYSIS_MIN_HOP)
+    STATE->analysisHop /= 2;
+  if (IsKeyPressed(KEY_RIGHT_BRACKET) &&
+      STATE->analysisHop * 2 <= ANALYSIS_MAX_HOP)
+    STATE->analysisHop *= 2;
+
+  // Shorter windows follow the music faster, longer ones resolve more
+  if (IsKeyPressed(KEY_MINUS) &&
+      STATE->analysisWindow / 2 >= ANALYSIS_MIN_WINDOW) {
+    STATE->analysisWindow /= 2;
+    resizeAnalysisWindow();
+  }
+  if (IsKeyPressed(KEY_EQUAL) &&
+      STATE->analysisWindow * 2 <= ANALYSIS_MAX_WINDOW) {
+    STATE->analysisWindow *= 2;
+    resizeAnalysisWindow();
+  }
+  if (IsKeyPressed(KEY_Z)) {
+    STATE->zeroPad =
+        STATE->zeroPad < ANALYSIS_MAX_ZERO_PAD ? 2 * STATE->zeroPad : 1;
+    resizeAnalysisWindow();
+  }
+
+  if (IsKeyPressed(KEY_C))
+    STATE->showChroma = !STATE->showChroma;
+
+  if (IsKeyPressed(KEY_I)) {
+    STATE->resolution = (STATE->resolution + 1) % RESOLUTION_COUNT;
+    resetFilter();
+  }
+
+  // Mid, side, then every channel on its own
+  if (IsKeyPressed(KEY_M)) {
+    if (STATE->downmix == DOWNMIX_MID) {
+      STATE->downmix = DOWNMIX_SIDE;
+    } else if (STATE->downmix == DOWNMIX_SIDE) {
+      STATE->downmix = DOWNMIX_CHANNEL;
+      STATE->downmixChannel = 0;
+    } else if (++STATE->downmixChannel >= FRAMES.channels) {
+      STATE->downmix = DOWNMIX_MID;
+      STATE->downmixChannel = 0;
+    }
+    resetFilter();
+  }
+
+  if (IsKeyPressed(KEY_L))
+    STATE->showLoudness = !STATE->showLoudness;
+
+  if (IsKeyPressed(KEY_F))
+    STATE->showFeatures = !STATE->showFeatures;
+
+  if (IsKeyPressed(KEY_A))
+    STATE->showSync = !STATE->showSync;
+
+  if (IsKeyPressed(KEY_T))
+    STATE->showTiming = !STATE->showTiming;
+  if (IsKeyPressed(KEY_COMMA) &&
+      STATE->syncTrimSeconds - SYNC_TRIM_STEP >= -SYNC_MAX_TRIM)
+    STATE->syncTrimSeconds -= SYNC_TRIM_STEP;
+  if (IsKeyPressed(KEY_PERIOD) &&
+      STATE->syncTrimSeconds + SYNC_TRIM_STEP <= SYNC_MAX_TRIM)
+    STATE->syncTrimSeconds += SYNC_TRIM_STEP;
+
+  if (STATE->displayMode == DISPLAY_FILTERBANK) {
+    if (IsKeyPressed(KEY_B))
+      STATE->filterbank.scale = STATE->filterbank.scale == FILTERBANK_MEL
+                                    ? FILTERBANK_ERB
+                                    : FILTERBANK_MEL;
+    if (IsKeyPressed(KEY_UP) &&
+        STATE->filterbank.bands + FILTERBANK_BANDS_STEP <=
+            SMOOTHED_AMPLITUDES_SIZE)
+      STATE->filterbank.bands += FILTERBANK_BANDS_STEP;
+    if (IsKeyPressed(KEY_DOWN) &&
+        STATE->filterbank.bands - FILTERBANK_BANDS_STEP >=
+            FILTERBANK_MIN_BANDS)
+      STATE->filterbank.bands -= FILTERBANK_BANDS_STEP;
+  }
+
   if (IsFileDropped()) {
     stopMusic();
+    discardPrefetch();
+    STATE->liveInput.enabled = false; // the files take over
     loadMusicFiles();
     STATE->timePlayedSeconds = 0.0f;
     startMusic();
   }
 
   if (IsMusicReady(MUSIC)) {
-    UpdateMusicStream(MUSIC); // Update music buffer with new stream data
+    if (!DECODER_THREADED)
+      refillMusic(); // Update music buffer with new stream data
+
+    if (!NEXT_QUEUED &&
+        (!PREFETCHING ||
+         atomic_load_explicit(&PREFETCH_DONE, memory_order_acquire)))
+      queueNext();
 
+    pthread_mutex_lock(&MUSIC_LOCK);
     // Restart music playing (stop and play)
     if (IsKeyPressed(KEY_SPACE)) {
+      unfollowMusic();
       StopMusicStream(MUSIC);
       resetFilter();
       PlayMusicStream(MUSIC);
+      followMusic(0.0f);
     }
 
     // Pause/Resume music playing
     if (IsKeyPressed(KEY_P)) {
 
       if (IsMusicStreamPlaying(MUSIC)) {
+        unfollowMusic();
         PauseMusicStream(MUSIC);
+        callTimingRestart(&STATE->refillTiming); // no refills meanwhile
       } else {
-        resetFilter();
         ResumeMusicStream(MUSIC);
+        followMusic(GetMusicTimePlayed(MUSIC));
       }
     }
 
-    if (IsKeyPressed(KEY_LEFT)) {
-      SeekMusicStream(MUSIC, GetMusicTimePlayed(MUSIC) - 5.0f);
-      resetFilter();
-    }
-
-    if (IsKeyPressed(KEY_RIGHT)) {
-      SeekMusicStream(MUSIC, GetMusicTimePlayed(MUSIC) + 5.0f);
-      resetFilter();
+    if (IsKeyPressed(KEY_LEFT))
+      seekMusic(GetMusicTimePlayed(MUSIC) - 5.0f);
+
+    if (IsKeyPressed(KEY_RIGHT))
+      seekMusic(GetMusicTimePlayed(MUSIC) + 5.0f);
+
+    // Gapless, then longer and longer crossfades
+    if (IsKeyPressed(KEY_X)) {
+      size_t i = 0;
+      while (i < ARRAY_LENGTH(CROSSFADE_STEPS) &&
+             CROSSFADE_STEPS[i] <= STATE->crossfadeSeconds)
+        ++i;
+      STATE->crossfadeSeconds =
+          i < ARRAY_LENGTH(CROSSFADE_STEPS) ? CROSSFADE_STEPS[i] : 0.0f;
+      printf("Crossfade: %.0f s\n", STATE->crossfadeSeconds);
+      if (atomic_load_explicit(&HANDOVER, memory_order_relaxed) !=
+          HANDOVER_DONE) {
+        unfollowMusic();
+        followMusic(GetMusicTimePlayed(MUSIC));
+      }
     }
 
     STATE->timePlayedSeconds = GetMusicTimePlayed(MUSIC);
-    if (STATE->timePlayedSeconds >=
-        GetMusicTimeLength(MUSIC) - 0.1f) { // Otherwise it may repeat
-      STATE->timePlayedSeconds = 0;
-      if (++STATE->musicFiles.currentlyPlayed >= STATE->musicFiles.count)
-        STATE->musicFiles.currentlyPlayed = 0;
-      stopMusic();
-      startMusic();
-    }
+    const bool ended =
+        atomic_load_explicit(&HANDOVER, memory_order_relaxed) == HANDOVER_DONE;
+    pthread_mutex_unlock(&MUSIC_LOCK);
+    if (ended)
+      nextTrack();
 
     if (IsKeyPressed(KEY_S)) {
       stopMusic();
+      discardPrefetch();
       unloadMusicFiles();
     }
   }
@@ -708,9 +2612,16 @@ void update(void) {
 
   ClearBackground(BLACK);
 
-  if (IsMusicReady(MUSIC)) {
+  if (inputReady()) {
 
+    publishAnalysisConfig();
     drawMusic();
+    if (STATE->showLoudness)
+      drawLoudness();
+    if (STATE->showSync)
+      drawSync();
+    if (STATE->showTiming)
+      drawTiming();
 
     if (STATE->showHelpInfo) {
       TIC = GetTime();
@@ -729,15 +2640,28 @@ void update(void) {
 
     if (STATE->showHelp) {
       DrawText("HIDE HELP:        'H'", 689, 20, 10, WHITE);
-      DrawText("TOGGLE BETWEEN WAVE AND FREQUENCY:        'W'", 523, 40, 10,
-               WHITE);
+      DrawText("SWITCH FREQUENCY / WAVE / FILTERBANK:        'W'", 505, 40,
+               10, WHITE);
       DrawText("STOP PLAYING:        'S'", 669, 60, 10, WHITE);
       DrawText("PAUSE/RESUME PLAYING:        'P'", 612, 80, 10, WHITE);
       DrawText("RESTART PLAYING: 'SPACE'", 647, 100, 10, WHITE);
       DrawText("SEEK BACKWARDS:       '<-' ", 652, 120, 10, WHITE);
       DrawText("SEEK FORWARDS:       '->'", 659, 140, 10, WHITE);
+      DrawText("FILTERBANK MEL/ERB:        'B'", 622, 160, 10, WHITE);
+      DrawText("FILTERBANK BANDS: 'UP'/'DOWN'", 619, 180, 10, WHITE);
+      DrawText("ANALYSIS HOP:       '['/']'", 645, 200, 10, WHITE);
+      DrawText("SHOW CHROMA AND KEY:        'C'", 609, 220, 10, WHITE);
+      DrawText("SHOW LOUDNESS:        'L'", 645, 240, 10, WHITE);
+      DrawText("FFT FULL / 1/4 / 1/4 + PEAKS / 1/4 + BASS:        'I'", 484,
+               260, 10, WHITE);
+      DrawText("MID / SIDE / CHANNELS:        'M'", 602, 280, 10, WHITE);
+      DrawText("A/V SYNC: 'A', TRIM: ','/'.'", 636, 300, 10, WHITE);
+      DrawText("GAPLESS / CROSSFADE:        'X'", 612, 320, 10, WHITE);
+      DrawText("AUDIO TIMING:        'T'", 655, 340, 10, WHITE);
+      DrawText("WINDOW: '-'/'=', ZERO PADDING: 'Z'", 583, 360, 10, WHITE);
+      DrawText("SHOW SPECTRAL FEATURES:        'F'", 580, 380, 10, WHITE);
 #if !FOR_WASM
-      DrawText("QUIT:        'Q'", 719, 160, 10, WHITE);
+      DrawText("QUIT:        'Q'", 719, 400, 10, WHITE);
 #endif
     }
 
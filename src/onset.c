@@ -0,0 +1,171 @@
+#include "onset.h"
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+// Beats are filled in for at most this many periods after the last onset
+#define TEMPO_FLYWHEEL_PERIODS 4.0
+
+void onsetInit(OnsetDetector *od, const double hopSeconds) {
+  od->hopSeconds = hopSeconds;
+  od->bands = 0;
+  od->recentHead = 0;
+  od->recentCount = 0;
+  od->previousFlux = 0.0f;
+  od->hopsPerFrame = 1;
+  if (hopSeconds > 0.0 && hopSeconds < TEMPO_FRAME_SECONDS)
+    od->hopsPerFrame = lround(TEMPO_FRAME_SECONDS / hopSeconds);
+  od->frameSeconds = od->hopsPerFrame * hopSeconds;
+  od->frameSum = 0.0f;
+  od->frameHops = 0;
+  od->fluxHead = 0;
+  od->fluxCount = 0;
+  od->framesSinceTempo = 0;
+  od->info = (BeatInfo){0};
+}
+
+static float spectralFlux(OnsetDetector *od, const float logBands[],
+                          const size_t n) {
+  if (n != od->bands || n == 0) {
+    // Nothing to compare with, e.g. after switching the display mode
+    od->bands = n < ONSET_MAX_BANDS ? n : ONSET_MAX_BANDS;
+    memcpy(od->previous, logBands, od->bands * sizeof(float));
+    return 0.0f;
+  }
+  float sum = 0.0f;
+  for (size_t i = 0; i < od->bands; ++i) {
+    const float rise = logBands[i] - od->previous[i];
+    sum += rise > 0.0f ? rise : 0.0f;
+    od->previous[i] = logBands[i];
+  }
+  return sum / od->bands;
+}
+
+// Flux of the frame `age` frames ago, 0 being the newest
+static inline float fluxAt(const OnsetDetector *od, const size_t age) {
+  return od->flux[(od->fluxHead + TEMPO_HISTORY - 1 - age) % TEMPO_HISTORY];
+}
+
+static float recentMeanFlux(const OnsetDetector *od) {
+  float sum = 0.0f;
+  for (size_t i = 0; i < od->recentCount; ++i)
+    sum += od->recent[i];
+  return od->recentCount > 0 ? sum / od->recentCount : 0.0f;
+}
+
+// Returns true when a frame was completed
+static bool addFlux(OnsetDetector *od, const float flux) {
+  od->recent[od->recentHead] = flux;
+  od->recentHead = (od->recentHead + 1) % ONSET_THRESHOLD_HOPS;
+  if (od->recentCount < ONSET_THRESHOLD_HOPS)
+    ++od->recentCount;
+
+  od->frameSum += flux;
+  if (++od->frameHops < od->hopsPerFrame)
+    return false;
+  od->flux[od->fluxHead] = od->frameSum / od->frameHops;
+  od->fluxHead = (od->fluxHead + 1) % TEMPO_HISTORY;
+  if (od->fluxCount < TEMPO_HISTORY)
+    ++od->fluxCount;
+  od->frameSum = 0.0f;
+  od->frameHops = 0;
+  return true;
+}
+
+static inline float tempoWeight(const float bpm) {
+  // Log-Gaussian with a standard deviation of one octave
+  const float octaves = log2f(bpm / TEMPO_PREFERRED_BPM);
+  return expf(-0.5f * octaves * octaves);
+}
+
+static void estimateTempo(OnsetDetector *od) {
+  const size_t count = od->fluxCount;
+  size_t minLag = floor(60.0 / (TEMPO_MAX_BPM * od->frameSeconds));
+  const size_t maxLag = ceil(60.0 / (TEMPO_MIN_BPM * od->frameSeconds));
+  if (minLag < 2)
+    minLag = 2;
+  if (2 * (maxLag + 1) > count || minLag >= maxLag)
+    return; // Not enough history yet
+
+  float history[TEMPO_HISTORY]; // oldest first, without its mean
+  float mean = 0.0f;
+  for (size_t i = 0; i < count; ++i) {
+    history[i] = fluxAt(od, count - 1 - i);
+    mean += history[i];
+  }
+  mean /= count;
+  for (size_t i = 0; i < count; ++i)
+    history[i] -= mean;
+
+  float correlation[maxLag + 2];
+  for (size_t lag = minLag - 1; lag <= maxLag + 1; ++lag) {
+    float sum = 0.0f;
+    for (size_t i = 0; i + lag < count; ++i)
+      sum += history[i] * history[i + lag];
+    correlation[lag] = sum / (count - lag);
+  }
+
+  size_t bestLag = 0;
+  float best = 0.0f;
+  for (size_t lag = minLag; lag <= maxLag; ++lag) {
+    const float weighted =
+        correlation[lag] * tempoWeight(60.0f / (lag * od->frameSeconds));
+    if (weighted > best) {
+      best = weighted;
+      bestLag = lag;
+    }
+  }
+  if (bestLag == 0)
+    return; // No periodicity
+
+  // Parabolic interpolation between the neighbouring lags
+  const float left = correlation[bestLag - 1];
+  const float center = correlation[bestLag];
+  const float right = correlation[bestLag + 1];
+  const float curvature = left - 2.0f * center + right;
+  float delta = curvature < 0.0f ? 0.5f * (left - right) / curvature : 0.0f;
+  if (delta < -0.5f || delta > 0.5f)
+    delta = 0.0f;
+
+  od->info.bpm = 60.0f / ((bestLag + delta) * od->frameSeconds);
+}
+
+bool onsetUpdate(OnsetDetector *od, const float logBands[], const size_t n,
+                 const double time, const double hopSeconds) {
+  if (hopSeconds != od->hopSeconds)
+    onsetInit(od, hopSeconds);
+
+  const float flux = spectralFlux(od, logBands, n);
+  const float threshold = ONSET_THRESHOLD_FACTOR * recentMeanFlux(od);
+  const bool framed = addFlux(od, flux);
+
+  BeatInfo *info = &od->info;
+  const bool onset = flux > threshold + FLT_EPSILON &&
+                     flux > od->previousFlux &&
+                     (info->onsets == 0 ||
+                      time - info->lastOnset >= ONSET_MIN_INTERVAL);
+  od->previousFlux = flux;
+  if (onset) {
+    info->lastOnset = time;
+    ++info->onsets;
+  }
+
+  if (framed && ++od->framesSinceTempo >= TEMPO_UPDATE_FRAMES) {
+    od->framesSinceTempo = 0;
+    estimateTempo(od);
+  }
+
+  const double period = info->bpm > 0.0f ? 60.0 / info->bpm : 0.0;
+  if (onset && (info->beats == 0 || time - info->lastBeat >= 0.5 * period)) {
+    info->lastBeat = time;
+    ++info->beats;
+    return true;
+  }
+  if (period > 0.0 && info->beats > 0 && time - info->lastBeat >= period &&
+      time - info->lastOnset < TEMPO_FLYWHEEL_PERIODS * period) {
+    info->lastBeat += period; // keep the beat grid
+    ++info->beats;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,69 @@
+#ifndef ONSET_H
+#define ONSET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define ONSET_MAX_BANDS 1024
+#define ONSET_THRESHOLD_HOPS 16 // moving average for the adaptive threshold
+#define ONSET_THRESHOLD_FACTOR 1.5f
+#define ONSET_MIN_INTERVAL 0.1 // seconds between two onsets
+#define TEMPO_FRAME_SECONDS 0.01 // onset strength is averaged to this rate
+#define TEMPO_HISTORY 1024       // frames of onset strength used for the tempo
+#define TEMPO_UPDATE_FRAMES 8    // frames between two tempo estimates
+#define TEMPO_MIN_BPM 60.0f
+#define TEMPO_MAX_BPM 200.0f
+#define TEMPO_PREFERRED_BPM 120.0f
+
+// What the renderer needs to react to the rhythm. `beats` and `onsets` count
+// the events so far, so a change tells that a new one happened.
+typedef struct {
+  float bpm; // 0 until a tempo was found
+  double lastOnset;
+  double lastBeat;
+  unsigned long onsets;
+  unsigned long beats;
+} BeatInfo;
+
+// Spectral-flux onset detector and autocorrelation tempo tracker, fed with
+// the log magnitudes of the bands that are drawn anyway.
+//
+// flux = mean over bands of max(0, band - previous band). An onset is a flux
+// that is a local rise above ONSET_THRESHOLD_FACTOR times its recent average.
+// The tempo is the lag with the strongest autocorrelation of the flux history
+// (weighted towards TEMPO_PREFERRED_BPM against octave errors). The history
+// holds the flux averaged over frames of about TEMPO_FRAME_SECONDS (or single
+// hops if they are longer), so it spans the longest beat period at any hop
+// and the autocorrelation costs the same. Beats are
+// onsets at least half a period after the previous beat, and a missing beat
+// is filled in one period after the last one, so the beat keeps going
+// through quiet passages.
+typedef struct {
+  double hopSeconds;
+  size_t bands;
+  float previous[ONSET_MAX_BANDS];
+  float recent[ONSET_THRESHOLD_HOPS]; // ring buffer of the flux of hops
+  size_t recentHead;
+  size_t recentCount;
+  float previousFlux;
+
+  size_t hopsPerFrame;
+  double frameSeconds; // hopsPerFrame hops
+  float frameSum;      // flux of the hops of the current frame
+  size_t frameHops;
+  float flux[TEMPO_HISTORY]; // ring buffer of frames, newest at fluxHead - 1
+  size_t fluxHead;
+  size_t fluxCount;
+  size_t framesSinceTempo;
+  BeatInfo info;
+} OnsetDetector;
+
+void onsetInit(OnsetDetector *od, const double hopSeconds);
+
+// Processes one analysis hop ending at `time` seconds. A different hop
+// duration restarts the detector, a different band count only the flux.
+// Returns true if a beat happened.
+bool onsetUpdate(OnsetDetector *od, const float logBands[], const size_t n,
+                 const double time, const double hopSeconds);
+
+#endif // ONSET_H
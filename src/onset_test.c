@@ -0,0 +1,45 @@
+#include "onset.h"
+#include <math.h>
+#include <stdio.h>
+
+#define SAMPLE_RATE 48000.0
+#define BANDS 32
+#define SECONDS 15.0
+#define CLICK_DECAY_SECONDS 0.05
+
+// Clicks at `bpm` as the log bands of hops of `hop` frames see them: a jump
+// in the hop of the click, then a decay
+static bool tracks(const unsigned int hop, const float bpm) {
+  OnsetDetector od;
+  onsetInit(&od, 0.0);
+  const double hopSeconds = hop / SAMPLE_RATE;
+  const double period = 60.0 / bpm;
+  float bands[BANDS];
+  unsigned long beats = 0;
+  for (unsigned long h = 1; h * hopSeconds < SECONDS; ++h) {
+    const double time = h * hopSeconds;
+    const double sinceClick = fmod(time, period);
+    const float level = expf(-sinceClick / CLICK_DECAY_SECONDS);
+    for (size_t b = 0; b < BANDS; ++b)
+      bands[b] = level * (1.0f + 0.01f * b);
+    beats += onsetUpdate(&od, bands, BANDS, time, hopSeconds);
+  }
+  const unsigned long clicks = SECONDS / period;
+  printf("%4u frame hops at %.0f BPM: %.2f BPM, %lu onsets, %lu beats of "
+         "%lu clicks\n",
+         hop, bpm, od.info.bpm, od.info.onsets, beats, clicks);
+  // Until the tempo is known and after a flywheel beat, a click may be
+  // skipped
+  return fabsf(od.info.bpm - bpm) < 0.02f * bpm && beats <= clicks + 1 &&
+         beats >= 0.8 * clicks;
+}
+
+int main(void) {
+  int failed = 0;
+  failed |= !tracks(128, 120.0f);
+  failed |= !tracks(1024, 120.0f);
+  failed |= !tracks(128, 90.0f);
+  failed |= !tracks(512, 140.0f);
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
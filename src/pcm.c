@@ -0,0 +1,133 @@
+#include "pcm.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool pcmParseFormat(const char *name, PcmSampleFormat *format) {
+  if (strcmp(name, "s16") == 0) {
+    *format = PCM_S16;
+    return true;
+  }
+  if (strcmp(name, "f32") == 0) {
+    *format = PCM_F32;
+    return true;
+  }
+  fprintf(stderr, "Unknown PCM format '%s', expected s16 or f32\n", name);
+  return false;
+}
+
+static inline size_t sampleBytes(const PcmSampleFormat format) {
+  return format == PCM_S16 ? sizeof(int16_t) : sizeof(float);
+}
+
+static void convert(const PcmSampleFormat format, const unsigned char in[],
+                    float out[], const size_t samples) {
+  if (format == PCM_F32) {
+    memcpy(out, in, samples * sizeof(float));
+    return;
+  }
+  int16_t s16[PCM_BLOCK_FRAMES * PCM_MAX_CHANNELS];
+  memcpy(s16, in, samples * sizeof(int16_t)); // `in` may be unaligned
+  for (size_t i = 0; i < samples; ++i)
+    out[i] = s16[i] * (1.0f / 32768.0f);
+}
+
+static void *readPcm(void *arg) {
+  PcmInput *in = arg;
+  const size_t frameBytes = in->channels * sampleBytes(in->format);
+  unsigned char bytes[PCM_BLOCK_FRAMES * PCM_MAX_CHANNELS * sizeof(float)];
+  float samples[PCM_BLOCK_FRAMES * PCM_MAX_CHANNELS];
+  const size_t capacity = PCM_BLOCK_FRAMES * frameBytes;
+  size_t pending = 0; // bytes of an incomplete frame
+
+  struct pollfd pfd = {.fd = in->fd, .events = POLLIN};
+  while (atomic_load_explicit(&in->running, memory_order_acquire)) {
+    const int ready = poll(&pfd, 1, PCM_POLL_MILLISECONDS);
+    if (ready == 0 || (ready == -1 && errno == EINTR))
+      continue;
+    const ssize_t n =
+        ready == -1 ? -1 : read(in->fd, &bytes[pending], capacity - pending);
+    if (n == -1 && (errno == EINTR || errno == EAGAIN))
+      continue;
+    if (n <= 0) {
+      if (n == -1)
+        fprintf(stderr, "Could not read PCM: %s\n", strerror(errno));
+      break;
+    }
+
+    pending += n;
+    const size_t frames = pending / frameBytes;
+    if (frames == 0)
+      continue;
+    convert(in->format, bytes, samples, frames * in->channels);
+    in->sink(samples, frames);
+    atomic_fetch_add_explicit(&in->frames, frames, memory_order_relaxed);
+    pending -= frames * frameBytes;
+    memmove(bytes, &bytes[frames * frameBytes], pending);
+  }
+  atomic_store_explicit(&in->ended, true, memory_order_release);
+  return NULL;
+}
+
+bool pcmOpen(PcmInput *in, const char *path, const PcmSampleFormat format,
+             const unsigned int sampleRate, const unsigned int channels,
+             PcmSink sink) {
+  in->open = false;
+  if (channels == 0 || channels > PCM_MAX_CHANNELS) {
+    fprintf(stderr, "PCM input supports 1 to %d channels, got %u\n",
+            PCM_MAX_CHANNELS, channels);
+    return false;
+  }
+  if (sampleRate == 0) {
+    fprintf(stderr, "PCM input needs a sample rate\n");
+    return false;
+  }
+
+  if (strcmp(path, "-") == 0) {
+    in->fd = STDIN_FILENO;
+    in->closeFd = false;
+  } else {
+    struct stat st;
+    const bool fifo = stat(path, &st) == 0 && S_ISFIFO(st.st_mode);
+    // Reading and writing, a pipe never blocks the open and never ends
+    in->fd = open(path, fifo ? O_RDWR : O_RDONLY);
+    if (in->fd == -1) {
+      fprintf(stderr, "Could not open %s: %s\n", path, strerror(errno));
+      return false;
+    }
+    in->closeFd = true;
+  }
+
+  in->format = format;
+  in->sampleRate = sampleRate;
+  in->channels = channels;
+  in->sink = sink;
+  atomic_store_explicit(&in->frames, 0, memory_order_relaxed);
+  atomic_store_explicit(&in->ended, false, memory_order_relaxed);
+  atomic_store_explicit(&in->running, true, memory_order_release);
+  const int err = pthread_create(&in->thread, NULL, readPcm, in);
+  if (err != 0) {
+    fprintf(stderr, "Could not start the PCM reader: %s\n", strerror(err));
+    if (in->closeFd)
+      close(in->fd);
+    return false;
+  }
+  in->open = true;
+  return true;
+}
+
+void pcmClose(PcmInput *in) {
+  if (!in->open)
+    return;
+  atomic_store_explicit(&in->running, false, memory_order_release);
+  pthread_join(in->thread, NULL);
+  if (in->closeFd)
+    close(in->fd);
+  in->open = false;
+}
+
+bool pcmIsOpen(const PcmInput *in) { return in->open; }
@@ -0,0 +1,59 @@
+#ifndef PCM_H
+#define PCM_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PCM_MAX_CHANNELS 8
+#define PCM_BLOCK_FRAMES 512    // at most this many frames per sink call
+#define PCM_POLL_MILLISECONDS 50 // how long pcmClose may wait for the reader
+
+typedef enum {
+  PCM_S16, // signed 16 bit
+  PCM_F32, // 32 bit float
+} PcmSampleFormat;
+
+// Receives interleaved float frames, like an audio stream processor
+typedef void (*PcmSink)(void *samples, unsigned int frames);
+
+// Raw interleaved PCM in native byte order from stdin, a file or a named
+// pipe, e.g. the output of `arecord -t raw` or `sox ... -t raw -`. A thread
+// reads whatever arrived, converts it to float and hands it to the sink in
+// blocks of whole frames, without a decoder and without buffering beyond a
+// block.
+//
+// A named pipe is opened for reading and writing, so that it stays open
+// while no one writes to it: the writer can be restarted without restarting
+// the input. For anything else the end of the data ends the input.
+typedef struct {
+  int fd;
+  bool closeFd; // false for stdin
+  PcmSampleFormat format;
+  unsigned int sampleRate;
+  unsigned int channels;
+  PcmSink sink;
+  bool open;
+  pthread_t thread;
+  _Atomic bool running;
+  _Atomic bool ended; // end of the data or a read error
+  _Atomic uint64_t frames;
+} PcmInput;
+
+// "s16" or "f32"
+bool pcmParseFormat(const char *name, PcmSampleFormat *format);
+
+// Opens `path` ("-" for stdin) and starts the reader. Fails if the channel
+// count is 0 or above PCM_MAX_CHANNELS or if the file cannot be opened.
+bool pcmOpen(PcmInput *in, const char *path, const PcmSampleFormat format,
+             const unsigned int sampleRate, const unsigned int channels,
+             PcmSink sink);
+
+// Stops the reader, which takes up to PCM_POLL_MILLISECONDS, and closes the
+// file. Does nothing if the input is not open.
+void pcmClose(PcmInput *in);
+
+bool pcmIsOpen(const PcmInput *in);
+
+#endif // PCM_H
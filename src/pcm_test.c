@@ -0,0 +1,103 @@
+#include "pcm.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CHANNELS 3
+#define FRAMES 10000
+#define CHUNK 7 // bytes per write, splits samples and frames
+
+static _Atomic unsigned long received = 0;
+static _Atomic unsigned long wrong = 0;
+
+// Sample c of frame i is (i % 1000 - 500 + c) / 1024, exact in s16 and f32
+static inline float expected(const unsigned long i, const unsigned int c) {
+  return ((float)(i % 1000) - 500.0f + c) / 1024.0f;
+}
+
+static void sink(void *buffer, unsigned int frames) {
+  const float *samples = buffer;
+  const unsigned long first = atomic_load(&received);
+  for (unsigned int i = 0; i < frames; ++i)
+    for (unsigned int c = 0; c < CHANNELS; ++c)
+      if (samples[i * CHANNELS + c] != expected(first + i, c))
+        atomic_fetch_add(&wrong, 1);
+  atomic_fetch_add(&received, frames);
+}
+
+static void writeAll(const int fd, const unsigned char *bytes,
+                     const size_t n) {
+  for (size_t i = 0; i < n; i += CHUNK)
+    if (write(fd, &bytes[i], n - i < CHUNK ? n - i : CHUNK) < 0)
+      perror("write");
+}
+
+static bool streamIsValid(const char *fifo, const PcmSampleFormat format) {
+  static unsigned char bytes[FRAMES * CHANNELS * sizeof(float)];
+  size_t n = 0;
+  for (unsigned long i = 0; i < FRAMES; ++i)
+    for (unsigned int c = 0; c < CHANNELS; ++c) {
+      const float x = expected(i, c);
+      if (format == PCM_S16) {
+        const int16_t s = x * 32768.0f;
+        memcpy(&bytes[n], &s, sizeof(s));
+        n += sizeof(s);
+      } else {
+        memcpy(&bytes[n], &x, sizeof(x));
+        n += sizeof(x);
+      }
+    }
+
+  atomic_store(&received, 0);
+  atomic_store(&wrong, 0);
+  PcmInput in = {0};
+  if (!pcmOpen(&in, fifo, format, 48000, CHANNELS, sink))
+    return false;
+  // The input keeps the pipe open, so a writer can come and go
+  for (int writer = 0; writer < 2; ++writer) {
+    const int fd = open(fifo, O_WRONLY);
+    writeAll(fd, &bytes[writer * n / 2], n / 2);
+    close(fd);
+  }
+  const struct timespec wait = {.tv_sec = 0, .tv_nsec = 1000000};
+  for (int i = 0; i < 1000 && atomic_load(&received) < FRAMES; ++i)
+    nanosleep(&wait, NULL);
+  const bool ended = atomic_load(&in.ended);
+  pcmClose(&in);
+
+  printf("%s: %lu of %d frames, %lu wrong samples%s\n",
+         format == PCM_S16 ? "s16" : "f32", atomic_load(&received), FRAMES,
+         atomic_load(&wrong), ended ? ", ended early" : "");
+  return atomic_load(&received) == FRAMES && atomic_load(&wrong) == 0 &&
+         !ended && !pcmIsOpen(&in);
+}
+
+int main(void) {
+  char fifo[] = "/tmp/pcm_test_XXXXXX";
+  if (mkdtemp(fifo) == NULL) {
+    perror("mkdtemp");
+    return EXIT_FAILURE;
+  }
+  char path[sizeof(fifo) + 8];
+  snprintf(path, sizeof(path), "%s/fifo", fifo);
+  if (mkfifo(path, 0600) != 0) {
+    perror("mkfifo");
+    return EXIT_FAILURE;
+  }
+
+  int failed = 0;
+  failed |= !streamIsValid(path, PCM_S16);
+  failed |= !streamIsValid(path, PCM_F32);
+
+  PcmSampleFormat format;
+  failed |= pcmParseFormat("s24", &format);
+
+  unlink(path);
+  rmdir(fifo);
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
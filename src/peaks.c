@@ -0,0 +1,175 @@
+#include "peaks.h"
+#include <math.h>
+#include <stdbool.h>
+
+// The Hann window's main lobe spans +-2 bins of the unpadded window. Its
+// sidelobes fall by 18 dB per octave, about 1 / (pi x^3), and are drawn
+// down to KERNEL_FLOOR of the largest peak, for at most +-16 bins.
+#define HANN_LOBE_HALF_WIDTH 2.0f
+#define HANN_KERNEL_HALF_WIDTH 16.0f
+#define KERNEL_FLOOR 1e-4f // -80 dB
+// A peak that a larger one's sidelobe explains to this fraction is that
+// sidelobe, not a tone
+#define SIDELOBE_FRACTION 0.5f
+
+size_t peaksFind(const float magnitudes[], const size_t n,
+                 SpectralPeak peaks[], const size_t capacity) {
+  float m = 0.0f;
+  for (size_t k = 0; k < n; ++k)
+    m = magnitudes[k] > m ? magnitudes[k] : m;
+  const float floor = PEAKS_MIN_RELATIVE * m;
+  if (floor <= 0.0f)
+    return 0;
+
+  size_t count = 0;
+  for (size_t k = 1; k + 1 < n && count < capacity; ++k) {
+    const float b = magnitudes[k];
+    if (b <= floor || b <= magnitudes[k - 1] || b < magnitudes[k + 1])
+      continue;
+    const float left = logf(magnitudes[k - 1] + floor * 1e-3f);
+    const float center = logf(b);
+    const float right = logf(magnitudes[k + 1] + floor * 1e-3f);
+    const float curvature = left - 2.0f * center + right;
+    float delta = curvature < 0.0f ? 0.5f * (left - right) / curvature : 0.0f;
+    if (delta < -0.5f || delta > 0.5f)
+      delta = 0.0f;
+    peaks[count++] = (SpectralPeak){
+        .bin = k + delta,
+        .magnitude = expf(center - 0.25f * (left - right) * delta),
+    };
+  }
+  return count;
+}
+
+// Magnitude response of the Hann window, main lobe and sidelobes, x in bins
+// of the unpadded window, normalized to 1 at x = 0, given sin(pi x)
+static inline float hannResponse(const float x, const float sinPiX) {
+  const float ax = fabsf(x);
+  if (ax >= HANN_KERNEL_HALF_WIDTH)
+    return 0.0f;
+  if (ax < 1e-4f)
+    return 1.0f;
+  if (fabsf(ax - 1.0f) < 1e-4f)
+    return 0.5f;
+  const float pi = M_PI;
+  return fabsf(sinPiX / (pi * ax * (1.0f - ax * ax)));
+}
+
+static inline float hannKernel(const float x) {
+  return hannResponse(x, sinf((float)M_PI * x));
+}
+
+// The kernel at x, x + 1 / padding, ... with the sine advanced by rotation
+// instead of a sinf per bin
+typedef struct {
+  float x, step;
+  float sin, cos;
+  float stepSin, stepCos;
+} HannSweep;
+
+static HannSweep hannSweep(const float x, const float padding) {
+  const float pi = M_PI;
+  return (HannSweep){
+      .x = x,
+      .step = 1.0f / padding,
+      .sin = sinf(pi * x),
+      .cos = cosf(pi * x),
+      .stepSin = sinf(pi / padding),
+      .stepCos = cosf(pi / padding),
+  };
+}
+
+static inline float hannNext(HannSweep *h) {
+  const float v = hannResponse(h->x, h->sin);
+  const float sin = h->sin * h->stepCos + h->cos * h->stepSin;
+  h->cos = h->cos * h->stepCos - h->sin * h->stepSin;
+  h->sin = sin;
+  h->x += h->step;
+  return v;
+}
+
+// Half width in bins of the unpadded window of a peak's kernel, `relative`
+// to the largest peak
+static float kernelReach(const float relative) {
+  const float pi = M_PI;
+  const float reach = cbrtf(relative / (pi * KERNEL_FLOOR));
+  return reach < HANN_LOBE_HALF_WIDTH     ? HANN_LOBE_HALF_WIDTH
+         : reach > HANN_KERNEL_HALF_WIDTH ? HANN_KERNEL_HALF_WIDTH
+                                          : reach;
+}
+
+// Whether a larger peak within reach of its kernel explains peak p. The
+// peaks are sorted by bin, so only the neighbours up to `reach` are looked
+// at.
+static bool isSidelobe(const SpectralPeak peaks[], const size_t count,
+                       const size_t p, const float padding,
+                       const float reach) {
+  const float threshold = SIDELOBE_FRACTION * peaks[p].magnitude;
+  for (size_t q = p; q-- > 0 && peaks[p].bin - peaks[q].bin < reach;)
+    if (peaks[q].magnitude > peaks[p].magnitude &&
+        peaks[q].magnitude *
+                hannKernel((peaks[p].bin - peaks[q].bin) / padding) >=
+            threshold)
+      return true;
+  for (size_t q = p + 1; q < count && peaks[q].bin - peaks[p].bin < reach;
+       ++q)
+    if (peaks[q].magnitude > peaks[p].magnitude &&
+        peaks[q].magnitude *
+                hannKernel((peaks[q].bin - peaks[p].bin) / padding) >=
+            threshold)
+      return true;
+  return false;
+}
+
+void peaksUpsample(const float magnitudes[], const size_t n,
+                   const SpectralPeak peaks[], const size_t count,
+                   const size_t factor, const float padding, float out[]) {
+  // Residual: the coarse spectrum without the kernels of the peaks
+  const float reach = HANN_KERNEL_HALF_WIDTH * padding; // in bins of either FFT
+  float largest = 0.0f;
+  for (size_t p = 0; p < count; ++p)
+    largest = peaks[p].magnitude > largest ? peaks[p].magnitude : largest;
+  for (size_t k = 0; k < n; ++k)
+    out[k] = magnitudes[k];
+  for (size_t p = 0; p < count; ++p) {
+    if (isSidelobe(peaks, count, p, padding, reach))
+      continue;
+    const float lobe = kernelReach(peaks[p].magnitude / largest) * padding;
+    const float lo = ceilf(peaks[p].bin - lobe);
+    const float hi = floorf(peaks[p].bin + lobe);
+    const size_t first = lo > 0.0f ? lo : 0;
+    const size_t last = hi < n - 1 ? hi : n - 1;
+    HannSweep h = hannSweep((first - peaks[p].bin) / padding, padding);
+    for (size_t k = first; k <= last; ++k) {
+      const float model = peaks[p].magnitude * hannNext(&h);
+      out[k] = out[k] > model ? out[k] - model : 0.0f;
+    }
+  }
+
+  // Upsampled linearly in place, from the end: bin k is written to
+  // k * factor and up, which only overlaps residual bins that were read.
+  for (size_t k = n; k-- > 0;) {
+    const float a = out[k];
+    const float b = k + 1 < n ? out[k + 1] : a;
+    for (size_t j = 0; j < factor; ++j)
+      out[k * factor + j] = a + (b - a) * j / factor;
+  }
+
+  // The narrow kernels of the longer window on top
+  const size_t total = n * factor;
+  for (size_t p = 0; p < count; ++p) {
+    if (isSidelobe(peaks, count, p, padding, reach))
+      continue;
+    const float lobe = kernelReach(peaks[p].magnitude / largest) * padding;
+    const float center = peaks[p].bin * factor;
+    const float lo = ceilf(center - lobe);
+    const float hi = floorf(center + lobe);
+    const size_t first = lo > 0.0f ? lo : 0;
+    const size_t last = hi < total - 1 ? hi : total - 1;
+    HannSweep h = hannSweep((first - center) / padding, padding);
+    for (size_t r = first; r <= last; ++r) {
+      const float v = peaks[p].magnitude * hannNext(&h);
+      out[r] = v > out[r] ? v : out[r];
+    }
+  }
+}
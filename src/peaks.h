@@ -0,0 +1,35 @@
+#ifndef PEAKS_H
+#define PEAKS_H
+
+#include <stddef.h>
+
+#define PEAKS_MIN_RELATIVE 1e-3f // peaks below this fraction of the maximum
+                                 // are left to the plain interpolation
+
+typedef struct {
+  float bin;       // refined position, in bins of the analyzed spectrum
+  float magnitude; // refined magnitude
+} SpectralPeak;
+
+// Finds the local maxima of n magnitudes and refines each one by fitting a
+// parabola through the log magnitudes of the peak bin and its neighbours
+// (Gaussian interpolation). For a Hann window the position error is below
+// 0.05 bins. Returns at most `capacity` peaks, from low to high bins.
+size_t peaksFind(const float magnitudes[], const size_t n,
+                 SpectralPeak peaks[], const size_t capacity);
+
+// Resamples n magnitudes to n * factor bins (out must hold that many), as a
+// `factor` times longer window would show them. Without peaks it
+// interpolates linearly. Otherwise the Hann response, main lobe and
+// sidelobes, of every peak is subtracted from the coarse spectrum, the
+// residual is interpolated, and each peak is drawn back as the narrower
+// response of the longer window, centered on the refined frequency. Peaks
+// that are mostly the sidelobe of a larger one are left out. `padding` is
+// the zero padding of both FFTs (FFT size / window size), which gives the
+// lobe width in bins. The peaks must be sorted by bin, as peaksFind returns
+// them.
+void peaksUpsample(const float magnitudes[], const size_t n,
+                   const SpectralPeak peaks[], const size_t count,
+                   const size_t factor, const float padding, float out[]);
+
+#endif // PEAKS_H
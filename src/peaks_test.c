@@ -0,0 +1,117 @@
+#include "fft.h"
+#include "peaks.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SAMPLE_RATE 48000.0f
+#define PADDING 2
+#define WINDOW 16384 // the full analysis window
+#define FACTOR 4     // the reduced one is this many times shorter
+#define FFT_SIZE (PADDING * WINDOW)
+#define BINS (FFT_SIZE / 2)
+#define REDUCED_BINS (BINS / FACTOR)
+#define MAX_PEAKS 2048
+#define COMPARED_HZ 2000.0f // bins above hold only leakage
+#define FLOOR 1e-4f         // relative to the maximum, for the logarithm
+
+#define MAX_TONES 4
+
+// Tones to compare the full and the reduced window on, and the largest
+// error of the reduced one with peaks and of its peak positions
+typedef struct {
+  const char *name;
+  size_t count;
+  float hz[MAX_TONES];
+  float amplitudes[MAX_TONES];
+  float maxError;
+  float maxBinsOff;
+} Mix;
+
+static float samples[FFT_SIZE];
+static float complex frequencies[FFT_SIZE];
+
+// The magnitudes of the last `window` samples of the mix, zero padded, at
+// the level of the full window
+static void magnitudes(const Mix *mix, const size_t window, float out[]) {
+  const size_t fftSize = PADDING * window;
+  for (size_t i = 0; i < window; ++i) {
+    const float t = (WINDOW - window + i) / SAMPLE_RATE;
+    float x = 0.0f;
+    for (size_t k = 0; k < mix->count; ++k)
+      x += mix->amplitudes[k] * sinf(2.0f * M_PI * mix->hz[k] * t);
+    samples[i] = 0.5f * (1.0f - cosf(2.0f * M_PI * i / window)) * x;
+  }
+  for (size_t i = window; i < fftSize; ++i)
+    samples[i] = 0.0f;
+  fft(samples, frequencies, fftSize);
+  for (size_t k = 0; k < fftSize / 2; ++k)
+    out[k] = cabsf(frequencies[k]) * WINDOW / window;
+}
+
+// Root mean square of the difference of the natural logarithms up to
+// COMPARED_HZ, with magnitudes below FLOOR times the maximum raised to it
+static float rmsLogError(const float reference[], const float m[]) {
+  float max = 0.0f;
+  for (size_t k = 0; k < BINS; ++k)
+    max = fmaxf(max, reference[k]);
+  const size_t n = COMPARED_HZ / (SAMPLE_RATE / FFT_SIZE);
+  double sum = 0.0;
+  for (size_t k = 1; k < n; ++k) {
+    const float d = logf(fmaxf(m[k], FLOOR * max)) -
+                    logf(fmaxf(reference[k], FLOOR * max));
+    sum += d * d;
+  }
+  return sqrt(sum / (n - 1));
+}
+
+static bool compare(const Mix *mix) {
+  static float reference[BINS], reduced[REDUCED_BINS];
+  static float linear[BINS], interpolated[BINS];
+  static SpectralPeak peaks[MAX_PEAKS];
+
+  printf("%s\n", mix->name);
+  magnitudes(mix, WINDOW, reference);
+  magnitudes(mix, WINDOW / FACTOR, reduced);
+  peaksUpsample(reduced, REDUCED_BINS, peaks, 0, FACTOR, PADDING, linear);
+  const size_t count = peaksFind(reduced, REDUCED_BINS, peaks, MAX_PEAKS);
+  peaksUpsample(reduced, REDUCED_BINS, peaks, count, FACTOR, PADDING,
+                interpolated);
+
+  // The tones are found within a fraction of a reduced bin
+  const float binHz = SAMPLE_RATE / (PADDING * WINDOW / FACTOR);
+  bool ok = true;
+  for (size_t t = 0; t < mix->count; ++t) {
+    float nearest = 1e9f;
+    for (size_t p = 0; p < count; ++p)
+      nearest = fminf(nearest, fabsf(peaks[p].bin * binHz - mix->hz[t]));
+    printf("  %.1f Hz: nearest peak %.3f bins off\n", mix->hz[t],
+           nearest / binHz);
+    ok &= nearest <= mix->maxBinsOff * binHz;
+  }
+
+  const float linearError = rmsLogError(reference, linear);
+  const float peaksError = rmsLogError(reference, interpolated);
+  printf("  RMS log error up to %.0f Hz against the full window: %.2f "
+         "linear, %.2f with %zu peaks\n",
+         COMPARED_HZ, linearError, peaksError, count);
+  return ok && peaksError <= mix->maxError;
+}
+
+int main(void) {
+  // The errors were 0.07 and 0.31 with peaks, 1.33 and 1.53 linear, when
+  // this was written. Neighbours pull the peaks of the second mix a little.
+  static const Mix MIXES[] = {
+      {"55, 83 and 440 Hz", 3, {55.0f, 83.0f, 440.0f}, {1.0f, 0.5f, 0.25f},
+       0.1f, 0.05f},
+      {"61.7, 97.3, 146.2 and 1234.5 Hz", 4,
+       {61.7f, 97.3f, 146.2f, 1234.5f}, {1.0f, 0.3f, 0.6f, 0.1f}, 0.4f,
+       0.2f},
+  };
+  int failed = 0;
+  for (size_t m = 0; m < sizeof(MIXES) / sizeof(MIXES[0]); ++m)
+    failed |= !compare(&MIXES[m]);
+
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
@@ -0,0 +1,127 @@
+#include "preroll.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// raylib decodes music with these (raudio.c), but declares neither them nor
+// the types behind music.ctxData in raylib.h
+typedef enum {
+  CONTEXT_WAV = 1,
+  CONTEXT_OGG = 2,
+  CONTEXT_MP3 = 4,
+  CONTEXT_QOA = 5,
+} ContextType; // MusicContextType of raudio.c
+
+unsigned long long drwav_read_pcm_frames_f32(void *wav,
+                                             unsigned long long frames,
+                                             float *out);
+unsigned long long drmp3_read_pcm_frames_f32(void *mp3,
+                                             unsigned long long frames,
+                                             float *out);
+int stb_vorbis_get_samples_float_interleaved(void *vorbis, int channels,
+                                             float *out, int floats);
+unsigned int qoaplay_decode(void *qoa, float *out, int frames);
+
+static bool supported(const Music music) {
+  return music.ctxType == CONTEXT_WAV || music.ctxType == CONTEXT_OGG ||
+         music.ctxType == CONTEXT_MP3 || music.ctxType == CONTEXT_QOA;
+}
+
+static size_t readFrames(const Music music, float out[], const size_t frames) {
+  switch (music.ctxType) {
+  case CONTEXT_WAV:
+    return drwav_read_pcm_frames_f32(music.ctxData, frames, out);
+  case CONTEXT_MP3:
+    return drmp3_read_pcm_frames_f32(music.ctxData, frames, out);
+  case CONTEXT_OGG:
+    return stb_vorbis_get_samples_float_interleaved(
+        music.ctxData, music.stream.channels, out,
+        frames * music.stream.channels);
+  case CONTEXT_QOA:
+    return qoaplay_decode(music.ctxData, out, frames);
+  default:
+    return 0;
+  }
+}
+
+// The frame SeekMusicStream goes to, computed the same way
+static unsigned int frameAt(const float seconds, const unsigned int rate) {
+  return (unsigned int)(seconds * rate);
+}
+
+// The gain of raylib's mixer for a stream with the pan at the center: its
+// sine approximation 0.5 * x * (3 - x * x) of the pan law at x = 0.5, only
+// applied to stereo output
+static float mixGain(const unsigned int channels) {
+  const float pan = 0.5f;
+  return channels == 2 ? 0.5f * pan * (3.0f - pan * pan) : 1.0f;
+}
+
+// Channel `c` of `to` channels made of a frame of `from` channels: mono goes
+// to every channel, everything goes into mono, the rest maps one to one
+static inline float mapChannel(const float frame[], const unsigned int from,
+                               const unsigned int to, const unsigned int c) {
+  if (from == 1)
+    return frame[0];
+  if (to == 1) {
+    float sum = 0.0f;
+    for (unsigned int i = 0; i < from; ++i)
+      sum += frame[i];
+    return sum / from;
+  }
+  return c < from ? frame[c] : 0.0f;
+}
+
+size_t prerollDecode(Music music, const float targetSeconds, float out[],
+                     const size_t frames, const unsigned int sampleRate,
+                     const unsigned int channels) {
+  const unsigned int rate = music.stream.sampleRate;
+  const unsigned int from = music.stream.channels;
+  const double step = (double)rate / sampleRate; // frames of the music
+  const unsigned int target = frameAt(targetSeconds, rate);
+  size_t wanted = ceil(frames * step);
+  if (wanted > target)
+    wanted = target;
+  if (wanted == 0 || !supported(music)) {
+    SeekMusicStream(music, targetSeconds);
+    return 0;
+  }
+
+  // Starts where the seek really lands, at or before target - wanted, so
+  // that the decoder ends up exactly at the target and the last seek has
+  // nothing to do
+  float startSeconds = (float)(target - wanted) / rate;
+  while (startSeconds > 0.0f && frameAt(startSeconds, rate) > target - wanted)
+    startSeconds = nextafterf(startSeconds, 0.0f);
+  const size_t length = target - frameAt(startSeconds, rate);
+
+  float *source = malloc(length * from * sizeof(float));
+  if (source == NULL) {
+    fprintf(stderr, "Could not allocate the pre-roll\n");
+    SeekMusicStream(music, targetSeconds);
+    return 0;
+  }
+  SeekMusicStream(music, startSeconds);
+  const size_t decoded = readFrames(music, source, length);
+  SeekMusicStream(music, targetSeconds);
+
+  // Frame j is at `decoded - (n - j) * step` of the source, so that the last
+  // one is a frame before the target
+  size_t n = decoded / step;
+  if (n > frames)
+    n = frames;
+  const float gain = mixGain(channels);
+  for (size_t j = 0; j < n; ++j) {
+    const double position = decoded - (n - j) * step;
+    const size_t i = position;
+    const size_t next = i + 1 < decoded ? i + 1 : decoded - 1;
+    const float t = position - i;
+    for (unsigned int c = 0; c < channels; ++c) {
+      const float a = mapChannel(&source[i * from], from, channels, c);
+      const float b = mapChannel(&source[next * from], from, channels, c);
+      out[j * channels + c] = gain * (a + (b - a) * t);
+    }
+  }
+  free(source);
+  return n;
+}
@@ -0,0 +1,25 @@
+#ifndef PREROLL_H
+#define PREROLL_H
+
+#include <raylib.h>
+#include <stddef.h>
+
+// Decodes the audio right before a seek target with the decoder of the
+// music itself, without playing it, so that the analysis can be warmed up
+// on it. The frames come out the way raylib's mixer would hand them to a
+// processor: converted (linearly) to the device's sample rate and channels
+// and scaled by the mixer's gain for a centered stream.
+//
+// Works for WAV, OGG, MP3 and QOA. Tracker modules (XM, MOD) have no
+// pre-roll.
+
+// Seeks `music` a little before `targetSeconds`, decodes up to `frames`
+// frames at `sampleRate` with `channels` into `out`, which end right before
+// the target, and leaves the decoder at the target. Returns the number of
+// frames, fewer close to the start of the music. The stream must be stopped
+// and nothing else may decode it meanwhile.
+size_t prerollDecode(Music music, const float targetSeconds, float out[],
+                     const size_t frames, const unsigned int sampleRate,
+                     const unsigned int channels);
+
+#endif // PREROLL_H
@@ -0,0 +1,81 @@
+#include "preroll.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SECONDS 3
+#define OUT_RATE 48000
+#define OUT_FRAMES 24000
+#define TOLERANCE 2e-3 // a frame of slope plus the linear interpolation
+
+static float out[OUT_FRAMES * 2];
+
+// Slow enough that linear interpolation is close to exact
+static double signal(const double t, const unsigned int c) {
+  return c == 0 ? 0.5 * sin(2.0 * M_PI * 5.0 * t)
+                : 0.25 * cos(2.0 * M_PI * 3.0 * t);
+}
+
+static bool writeWave(const char *path, const unsigned int rate,
+                      const unsigned int channels) {
+  const unsigned int frames = SECONDS * rate;
+  float *data = malloc(frames * channels * sizeof(float));
+  for (unsigned int i = 0; i < frames; ++i)
+    for (unsigned int c = 0; c < channels; ++c)
+      data[i * channels + c] = signal((double)i / rate, c);
+  const Wave wave = {.frameCount = frames,
+                     .sampleRate = rate,
+                     .sampleSize = 32,
+                     .channels = channels,
+                     .data = data};
+  const bool exported = ExportWave(wave, path);
+  free(data);
+  return exported;
+}
+
+// Decodes the pre-roll of `target` seconds and compares it with the signal
+static bool prerollIsValid(const char *path, const unsigned int channels,
+                           const float target, const size_t expected) {
+  Music music = LoadMusicStream(path);
+  if (!IsMusicReady(music))
+    return false;
+  const size_t n = prerollDecode(music, target, out, OUT_FRAMES, OUT_RATE, 2);
+  const float played = GetMusicTimePlayed(music);
+  const unsigned int from = music.stream.channels;
+  UnloadMusicStream(music);
+
+  const double gain = 0.6875; // raylib's mixer, stereo, centered
+  double error = 0.0;
+  for (size_t j = 0; j < n; ++j)
+    for (unsigned int c = 0; c < 2; ++c) {
+      const double t = target - (double)(n - j) / OUT_RATE;
+      const double x = gain * signal(t, from == 1 ? 0 : c);
+      error = fmax(error, fabs(out[j * 2 + c] - x));
+    }
+  printf("%u channel(s) at %.2f s: %zu frames, error %.5f, at %.4f s\n",
+         channels, target, n, error, played);
+  return labs((long)n - (long)expected) <= 2 && error < TOLERANCE &&
+         fabsf(played - target) < 1e-3f;
+}
+
+int main(void) {
+  SetTraceLogLevel(LOG_WARNING);
+  InitAudioDevice(); // raylib needs it to load music, any backend will do
+
+  const char *stereo = "/tmp/preroll_test_stereo.wav";
+  const char *mono = "/tmp/preroll_test_mono.wav";
+  int failed = !writeWave(stereo, 44100, 2) || !writeWave(mono, 22050, 1);
+  if (!failed) {
+    failed |= !prerollIsValid(stereo, 2, 2.0f, OUT_FRAMES);
+    failed |= !prerollIsValid(mono, 1, 2.0f, OUT_FRAMES);
+    // Only what there is before the target
+    failed |= !prerollIsValid(stereo, 2, 0.1f, OUT_RATE / 10);
+    failed |= !prerollIsValid(stereo, 2, 0.0f, 0);
+  }
+
+  CloseAudioDevice();
+  remove(stereo);
+  remove(mono);
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
@@ -0,0 +1,183 @@
+#define _GNU_SOURCE // CPU affinity
+#include "realtime.h"
+#include <errno.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#define REALTIME_AFFINITY 1
+#else
+#define REALTIME_AFFINITY 0
+#endif
+
+static bool parseCpus(const char *list, uint64_t *cpus) {
+  *cpus = 0;
+  do {
+    char *end;
+    const unsigned long cpu = strtoul(list, &end, 10);
+    if (end == list || cpu >= REALTIME_MAX_CPUS)
+      return false;
+    *cpus |= (uint64_t)1 << cpu;
+    list = end;
+  } while (*list++ == ',');
+  return list[-1] == '\0';
+}
+
+bool realtimeParse(const char *spec, ThreadSchedule *schedule) {
+  ThreadSchedule s = {.policy = REALTIME_KEEP};
+  const char *at = strchr(spec, '@');
+  const size_t length = at != NULL ? (size_t)(at - spec) : strlen(spec);
+  if (at != NULL && !parseCpus(at + 1, &s.cpus))
+    return false;
+
+  if (length == 5 && strncmp(spec, "other", 5) == 0) {
+    s.policy = REALTIME_OTHER;
+  } else if (length > 0) {
+    const char *colon = memchr(spec, ':', length);
+    if (colon == NULL)
+      return false;
+    const size_t name = colon - spec;
+    if (name == 4 && strncmp(spec, "fifo", 4) == 0)
+      s.policy = REALTIME_FIFO;
+    else if (name == 2 && strncmp(spec, "rr", 2) == 0)
+      s.policy = REALTIME_RR;
+    else
+      return false;
+    char *end;
+    const long priority = strtol(colon + 1, &end, 10);
+    if (end != spec + length || end == colon + 1 || priority < 1 ||
+        priority > 99)
+      return false;
+    s.priority = priority;
+  }
+  *schedule = s;
+  return true;
+}
+
+bool realtimeRequested(const ThreadSchedule *schedule) {
+  return schedule->policy != REALTIME_KEEP || schedule->cpus != 0;
+}
+
+static int schedPolicy(const RealtimePolicy policy) {
+  switch (policy) {
+  case REALTIME_FIFO:
+    return SCHED_FIFO;
+  case REALTIME_RR:
+    return SCHED_RR;
+  default:
+    return SCHED_OTHER;
+  }
+}
+
+static const char *policyName(const int policy) {
+  switch (policy) {
+  case SCHED_FIFO:
+    return "SCHED_FIFO";
+  case SCHED_RR:
+    return "SCHED_RR";
+  case SCHED_OTHER:
+    return "SCHED_OTHER";
+  default:
+    return "another policy";
+  }
+}
+
+// Appends to a report, cut at its size
+static void append(char report[], const size_t size, const char *format,
+                   ...) {
+  const size_t used = strlen(report);
+  if (used + 1 >= size)
+    return;
+  va_list args;
+  va_start(args, format);
+  vsnprintf(&report[used], size - used, format, args);
+  va_end(args);
+}
+
+static void appendCpus(char report[], const size_t size,
+                       const uint64_t cpus) {
+  const char *separator = "";
+  for (int cpu = 0; cpu < REALTIME_MAX_CPUS; ++cpu)
+    if (cpus & ((uint64_t)1 << cpu)) {
+      append(report, size, "%s%d", separator, cpu);
+      separator = ",";
+    }
+}
+
+bool realtimeApply(pthread_t thread, const ThreadSchedule *schedule,
+                   char report[], const size_t size) {
+  char denied[REALTIME_REPORT_SIZE] = "";
+  bool applied = true;
+
+  if (schedule->policy != REALTIME_KEEP) {
+    const int policy = schedPolicy(schedule->policy);
+    const bool realtime = policy != SCHED_OTHER;
+    struct sched_param param = {.sched_priority =
+                                    realtime ? schedule->priority : 0};
+    int err = pthread_setschedparam(thread, policy, &param);
+    struct rlimit limit;
+    if (err == EPERM && realtime && getrlimit(RLIMIT_RTPRIO, &limit) == 0 &&
+        limit.rlim_cur > 0 &&
+        limit.rlim_cur < (rlim_t)schedule->priority) {
+      // As high as an unprivileged thread may go
+      param.sched_priority = limit.rlim_cur;
+      err = pthread_setschedparam(thread, policy, &param);
+      if (err == 0) {
+        append(denied, sizeof(denied), "%s %d: above RLIMIT_RTPRIO",
+               policyName(policy), schedule->priority);
+        applied = false;
+      }
+    }
+    if (err != 0) {
+      append(denied, sizeof(denied), "%s %d: %s", policyName(policy),
+             param.sched_priority, strerror(err));
+      applied = false;
+    }
+  }
+
+  uint64_t cpus = 0;
+  if (schedule->cpus != 0) {
+#if REALTIME_AFFINITY
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu = 0; cpu < REALTIME_MAX_CPUS; ++cpu)
+      if (schedule->cpus & ((uint64_t)1 << cpu))
+        CPU_SET(cpu, &set);
+    const int err = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (err == 0) {
+      cpus = schedule->cpus;
+    } else {
+      append(denied, sizeof(denied), "%sCPUs ", *denied ? ", " : "");
+      appendCpus(denied, sizeof(denied), schedule->cpus);
+      append(denied, sizeof(denied), ": %s", strerror(err));
+      applied = false;
+    }
+#else
+    append(denied, sizeof(denied), "%sCPU pinning: not supported",
+           *denied ? ", " : "");
+    applied = false;
+#endif // REALTIME_AFFINITY
+  }
+
+  // What the thread has now
+  report[0] = '\0';
+  int policy;
+  struct sched_param param;
+  if (pthread_getschedparam(thread, &policy, &param) != 0)
+    append(report, size, "unknown policy");
+  else if (policy == SCHED_FIFO || policy == SCHED_RR)
+    append(report, size, "%s %d", policyName(policy), param.sched_priority);
+  else
+    append(report, size, "%s", policyName(policy));
+  if (cpus != 0) {
+    append(report, size, " on CPUs ");
+    appendCpus(report, size, cpus);
+  }
+  if (*denied)
+    append(report, size, " (%s)", denied);
+  return applied;
+}
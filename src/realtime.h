@@ -0,0 +1,45 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define REALTIME_MAX_CPUS 64
+#define REALTIME_REPORT_SIZE 192
+
+// How a thread should be scheduled: a policy, its priority and the CPUs it
+// may run on. The real-time policies need CAP_SYS_NICE or an RLIMIT_RTPRIO
+// (`rtprio` in /etc/security/limits.conf). Without them the thread keeps its
+// policy, and what it got is reported instead.
+typedef enum {
+  REALTIME_KEEP,  // whatever the thread has
+  REALTIME_OTHER, // SCHED_OTHER
+  REALTIME_FIFO,  // SCHED_FIFO
+  REALTIME_RR,    // SCHED_RR
+} RealtimePolicy;
+
+typedef struct {
+  RealtimePolicy policy;
+  int priority;  // of SCHED_FIFO and SCHED_RR, 1 to 99 on Linux
+  uint64_t cpus; // bit i for CPU i, 0 for all of them
+} ThreadSchedule;
+
+// Parses "fifo:PRIORITY", "rr:PRIORITY" or "other", optionally followed by
+// "@" and a comma separated list of CPUs below REALTIME_MAX_CPUS, or only the
+// CPUs: "fifo:80", "rr:50@2,3", "@1". Fails on anything else.
+bool realtimeParse(const char *spec, ThreadSchedule *schedule);
+
+// Whether the schedule changes anything.
+bool realtimeRequested(const ThreadSchedule *schedule);
+
+// Applies `schedule` to `thread` as far as the permissions allow. A priority
+// above RLIMIT_RTPRIO is lowered to it. Describes what the thread got and
+// what was denied in `report`, e.g. "SCHED_FIFO 80 on CPUs 2,3" or
+// "SCHED_OTHER (SCHED_FIFO 80: Operation not permitted)". Returns whether
+// everything was applied as requested.
+bool realtimeApply(pthread_t thread, const ThreadSchedule *schedule,
+                   char report[], const size_t size);
+
+#endif // REALTIME_H
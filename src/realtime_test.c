@@ -0,0 +1,69 @@
+#include "realtime.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool parses(const char *spec, const RealtimePolicy policy,
+                   const int priority, const uint64_t cpus) {
+  ThreadSchedule s;
+  const bool parsed = realtimeParse(spec, &s) && s.policy == policy &&
+                      s.priority == priority && s.cpus == cpus;
+  printf("%-16s %s\n", spec, parsed ? "parsed" : "NOT PARSED");
+  return parsed;
+}
+
+static bool rejects(const char *spec) {
+  ThreadSchedule s;
+  const bool rejected = !realtimeParse(spec, &s);
+  printf("%-16s %s\n", spec, rejected ? "rejected" : "NOT REJECTED");
+  return rejected;
+}
+
+int main(void) {
+  int failed = 0;
+
+  failed |= !parses("", REALTIME_KEEP, 0, 0);
+  failed |= !parses("other", REALTIME_OTHER, 0, 0);
+  failed |= !parses("fifo:80", REALTIME_FIFO, 80, 0);
+  failed |= !parses("rr:1@0", REALTIME_RR, 1, 1);
+  failed |= !parses("fifo:99@2,3", REALTIME_FIFO, 99, 0xc);
+  failed |= !parses("@63", REALTIME_KEEP, 0, (uint64_t)1 << 63);
+  failed |= !parses("other@1,0", REALTIME_OTHER, 0, 3);
+
+  failed |= !rejects("fifo");
+  failed |= !rejects("fifo:");
+  failed |= !rejects("fifo:0");
+  failed |= !rejects("rr:100");
+  failed |= !rejects("fifo:80x");
+  failed |= !rejects("idle:1");
+  failed |= !rejects("other:1");
+  failed |= !rejects("@");
+  failed |= !rejects("@64");
+  failed |= !rejects("@1,");
+  failed |= !rejects("@1;2");
+
+  // Whatever the permissions are, the thread ends up with a report
+  const char *specs[] = {"other", "@0", "fifo:10@0", "rr:99"};
+  for (size_t i = 0; i < sizeof(specs) / sizeof(specs[0]); ++i) {
+    ThreadSchedule s;
+    char report[REALTIME_REPORT_SIZE];
+    realtimeParse(specs[i], &s);
+    const bool applied =
+        realtimeApply(pthread_self(), &s, report, sizeof(report));
+    printf("%-16s %s: %s\n", specs[i], applied ? "applied" : "not applied",
+           report);
+    failed |= strlen(report) == 0;
+    // SCHED_OTHER and CPU 0 are always allowed
+    failed |= i < 2 && !applied;
+  }
+
+  // A report that does not fit is cut, and the thread is back to normal
+  ThreadSchedule s;
+  char tiny[8];
+  realtimeParse("other@0", &s);
+  realtimeApply(pthread_self(), &s, tiny, sizeof(tiny));
+  failed |= strlen(tiny) != sizeof(tiny) - 1;
+
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
@@ -0,0 +1,270 @@
+#include "ring.h"
+#include "simd.h"
+#include <stdio.h>
+#include <string.h>
+
+bool ringInit(Ring *ring, float samples[], const size_t capacity,
+              const size_t stride) {
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+    fprintf(stderr, "Ring capacity must be a power of two, got %zu\n",
+            capacity);
+    return false;
+  }
+  if (stride == 0) {
+    fprintf(stderr, "Ring needs at least one channel\n");
+    return false;
+  }
+  ring->samples = samples;
+  ring->capacity = capacity;
+  ring->stride = stride;
+  ring->channels = stride < RING_MAX_CHANNELS ? stride : RING_MAX_CHANNELS;
+  ringReset(ring);
+  return true;
+}
+
+void ringReset(Ring *ring) {
+  atomic_store_explicit(&ring->claimed, 0, memory_order_relaxed);
+  atomic_store_explicit(&ring->consumed, 0, memory_order_relaxed);
+  ring->first = 0;
+  atomic_store_explicit(&ring->writes, 0, memory_order_relaxed);
+  atomic_store_explicit(&ring->droppedFrames, 0, memory_order_relaxed);
+  atomic_store_explicit(&ring->droppedWrites, 0, memory_order_relaxed);
+  atomic_store_explicit(&ring->stamped, 0, memory_order_relaxed);
+  atomic_store_explicit(&ring->written, 0, memory_order_release);
+}
+
+static inline uint64_t oldestKept(const Ring *ring, const uint64_t written) {
+  const uint64_t oldest =
+      written > ring->capacity ? written - ring->capacity : 0;
+  return oldest > ring->first ? oldest : ring->first;
+}
+
+bool ringMove(Ring *ring, float samples[], const size_t capacity) {
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+    fprintf(stderr, "Ring capacity must be a power of two, got %zu\n",
+            capacity);
+    return false;
+  }
+  const uint64_t written =
+      atomic_load_explicit(&ring->written, memory_order_relaxed);
+  const uint64_t kept = oldestKept(ring, written);
+  const uint64_t start =
+      written - kept > capacity ? written - capacity : kept;
+  ring->first = start;
+  for (size_t c = 0; c < ring->channels; ++c) {
+    const float *from = &ring->samples[c * ring->capacity];
+    float *to = &samples[c * capacity];
+    for (uint64_t i = start; i < written; ++i)
+      to[i & (capacity - 1)] = from[i & (ring->capacity - 1)];
+  }
+  ring->samples = samples;
+  ring->capacity = capacity;
+  return true;
+}
+
+// Counts the unconsumed frames that writing up to `end` pushes out
+static void countDropped(Ring *ring, const uint64_t written,
+                         const uint64_t end) {
+  const uint64_t consumed =
+      atomic_load_explicit(&ring->consumed, memory_order_relaxed);
+  const uint64_t previous = oldestKept(ring, written);
+  const uint64_t from = consumed > previous ? consumed : previous;
+  const uint64_t to = oldestKept(ring, end);
+  if (to > from) {
+    atomic_store_explicit(
+        &ring->droppedFrames,
+        atomic_load_explicit(&ring->droppedFrames, memory_order_relaxed) +
+            (to - from),
+        memory_order_relaxed);
+    atomic_store_explicit(
+        &ring->droppedWrites,
+        atomic_load_explicit(&ring->droppedWrites, memory_order_relaxed) + 1,
+        memory_order_relaxed);
+  }
+}
+
+// Copies `frames` interleaved frames to the planes starting at `offset`
+static void deinterleave(Ring *ring, const size_t offset, const float in[],
+                         const size_t frames) {
+  const size_t stride = ring->stride;
+  float *left = &ring->samples[offset];
+  if (stride == 1) {
+    memcpy(left, in, frames * sizeof(float));
+    return;
+  }
+  if (stride == 2) {
+    float *right = &ring->samples[ring->capacity + offset];
+    size_t i = 0;
+#ifdef VF_WIDTH
+    for (; i + VF_WIDTH <= frames; i += VF_WIDTH) {
+      vf even, odd;
+      vfDeinterleave(&in[2 * i], &even, &odd);
+      vfStore(&left[i], even);
+      vfStore(&right[i], odd);
+    }
+#endif // VF_WIDTH
+    for (; i < frames; ++i) {
+      left[i] = in[2 * i];
+      right[i] = in[2 * i + 1];
+    }
+    return;
+  }
+  for (size_t c = 0; c < ring->channels; ++c) {
+    float *plane = &ring->samples[c * ring->capacity + offset];
+    for (size_t i = 0; i < frames; ++i)
+      plane[i] = in[i * stride + c];
+  }
+}
+
+// Publishes the stamp of a write that ended at frame `end`
+static void stamp(Ring *ring, const uint64_t end, const size_t frames,
+                  const double time) {
+  const uint64_t n = atomic_load_explicit(&ring->stamped, memory_order_relaxed);
+  RingStamp next = {.frame = end, .time = time, .frames = frames};
+  if (n > 0) {
+    const RingStamp *previous = &ring->stamps[(n - 1) % RING_STAMPS];
+    if (time - previous->time < RING_BURST_SECONDS) {
+      next.time = previous->time;
+      next.frames += previous->frames;
+    }
+  }
+  ring->stamps[n % RING_STAMPS] = next;
+  atomic_store_explicit(&ring->stamped, n + 1, memory_order_release);
+}
+
+void ringWrite(Ring *ring, const float samples[], size_t frames,
+               const double time) {
+  const size_t blockFrames = frames;
+  uint64_t end = atomic_load_explicit(&ring->written, memory_order_relaxed);
+  countDropped(ring, end, end + frames);
+  atomic_store_explicit(
+      &ring->writes,
+      atomic_load_explicit(&ring->writes, memory_order_relaxed) + 1,
+      memory_order_relaxed);
+  if (frames > ring->capacity) {
+    // The skipped frames count as written, they are just gone already
+    samples += (frames - ring->capacity) * ring->stride;
+    end += frames - ring->capacity;
+    frames = ring->capacity;
+  }
+  atomic_store_explicit(&ring->claimed, end + frames, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release); // claim before the copy
+
+  const size_t mask = ring->capacity - 1;
+  const size_t first = end & mask;
+  const size_t head = frames < ring->capacity - first ? frames
+                                                      : ring->capacity - first;
+  deinterleave(ring, first, samples, head);
+  deinterleave(ring, 0, &samples[head * ring->stride], frames - head);
+
+  atomic_store_explicit(&ring->written, end + frames, memory_order_release);
+  stamp(ring, end + frames, blockFrames, time);
+}
+
+uint64_t ringWritten(const Ring *ring) {
+  return atomic_load_explicit(&ring->written, memory_order_acquire);
+}
+
+uint64_t ringOldest(const Ring *ring) {
+  return oldestKept(ring, ringWritten(ring));
+}
+
+void ringConsume(Ring *ring, const uint64_t frame) {
+  if (frame > atomic_load_explicit(&ring->consumed, memory_order_relaxed))
+    atomic_store_explicit(&ring->consumed, frame, memory_order_relaxed);
+}
+
+bool ringLatestStamp(const Ring *ring, RingStamp *stamp) {
+  for (;;) {
+    const uint64_t n =
+        atomic_load_explicit(&ring->stamped, memory_order_acquire);
+    if (n == 0)
+      return false;
+    *stamp = ring->stamps[(n - 1) % RING_STAMPS];
+    atomic_thread_fence(memory_order_acquire); // the copy before the check
+    // The producer reuses a slot only RING_STAMPS - 1 stamps later
+    if (atomic_load_explicit(&ring->stamped, memory_order_relaxed) - n <
+        RING_STAMPS - 1)
+      return true;
+  }
+}
+
+RingStats ringStats(const Ring *ring) {
+  return (RingStats){
+      .writes = atomic_load_explicit(&ring->writes, memory_order_relaxed),
+      .frames = atomic_load_explicit(&ring->written, memory_order_acquire),
+      .droppedFrames =
+          atomic_load_explicit(&ring->droppedFrames, memory_order_relaxed),
+      .droppedWrites =
+          atomic_load_explicit(&ring->droppedWrites, memory_order_relaxed),
+  };
+}
+
+// Whether the frames from `start` on were still intact after reading them
+static bool stillValid(const Ring *ring, const uint64_t start) {
+  atomic_thread_fence(memory_order_acquire);
+  const uint64_t claimed =
+      atomic_load_explicit(&ring->claimed, memory_order_relaxed);
+  return claimed <= start + ring->capacity;
+}
+
+static inline bool isWritten(const Ring *ring, const uint64_t start,
+                             const size_t frames) {
+  const uint64_t written =
+      atomic_load_explicit(&ring->written, memory_order_acquire);
+  return frames <= ring->capacity && start >= ring->first &&
+         start + frames <= written;
+}
+
+bool ringReadChannel(const Ring *ring, const size_t channel,
+                     const uint64_t start, const size_t frames, float out[]) {
+  if (channel >= ring->channels || !isWritten(ring, start, frames))
+    return false;
+
+  const size_t first = start & (ring->capacity - 1);
+  const size_t head = frames < ring->capacity - first ? frames
+                                                      : ring->capacity - first;
+  const float *plane = &ring->samples[channel * ring->capacity];
+  memcpy(out, &plane[first], head * sizeof(float));
+  memcpy(&out[head], plane, (frames - head) * sizeof(float));
+  return stillValid(ring, start);
+}
+
+// out[i] (+)= weight * plane[i]
+static void mixPlane(float out[], const float plane[], const size_t n,
+                     const float weight, const bool accumulate) {
+  size_t i = 0;
+#ifdef VF_WIDTH
+  const vf w = vfSet(weight);
+  if (accumulate) {
+    for (; i + VF_WIDTH <= n; i += VF_WIDTH)
+      vfStore(&out[i], vfAdd(vfLoad(&out[i]), vfMul(w, vfLoad(&plane[i]))));
+  } else {
+    for (; i + VF_WIDTH <= n; i += VF_WIDTH)
+      vfStore(&out[i], vfMul(w, vfLoad(&plane[i])));
+  }
+#endif // VF_WIDTH
+  if (accumulate) {
+    for (; i < n; ++i)
+      out[i] += weight * plane[i];
+  } else {
+    for (; i < n; ++i)
+      out[i] = weight * plane[i];
+  }
+}
+
+bool ringReadMix(const Ring *ring, const float weights[], const uint64_t start,
+                 const size_t frames, float out[]) {
+  if (!isWritten(ring, start, frames))
+    return false;
+
+  const size_t first = start & (ring->capacity - 1);
+  const size_t head = frames < ring->capacity - first ? frames
+                                                      : ring->capacity - first;
+  for (size_t c = 0; c < ring->channels; ++c) {
+    const float *plane = &ring->samples[c * ring->capacity];
+    mixPlane(out, &plane[first], head, weights[c], c > 0);
+    mixPlane(&out[head], plane, frames - head, weights[c], c > 0);
+  }
+  return stillValid(ring, start);
+}
@@ -0,0 +1,115 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RING_MAX_CHANNELS 8 // 7.1
+#define RING_STAMPS 16
+#define RING_BURST_SECONDS 0.001 // writes closer than this share a callback
+
+// Single-producer ring of float frames that is overwritten, not consumed:
+// the producer (the audio callback) never waits and never moves memory,
+// readers copy any window of the last `capacity` frames without a lock.
+//
+// The producer writes interleaved blocks of `stride` channels, the ring
+// keeps the first `channels` of them planar (one run of `capacity` floats
+// per channel), so that a reader copies or mixes contiguous floats. Stereo
+// is deinterleaved with vector shuffles.
+//
+// Frames are addressed by their absolute index since the last reset. The
+// producer first announces how far it is going to write (`claimed`), then
+// copies, then publishes (`written`). A reader copies a window and checks
+// afterwards that the producer has not claimed it in the meantime, like a
+// seqlock, so a returned window is always consistent.
+//
+// The writes never fail, but frames can be overwritten before the reader
+// got to them. The reader reports its progress with ringConsume and the
+// producer counts every frame it overwrites before that point.
+//
+// Every write is stamped with the time it happened, so a reader can tell
+// which frame is being played. Writes within RING_BURST_SECONDS of the
+// first one of a burst belong to the same device callback and share its
+// time.
+typedef struct {
+  uint64_t frame;  // index after the newest frame of the burst so far
+  double time;     // seconds, when the burst started
+  uint64_t frames; // written in the burst so far
+} RingStamp;
+
+typedef struct {
+  float *samples;
+  size_t capacity; // frames, a power of two
+  size_t channels; // kept, at most RING_MAX_CHANNELS
+  size_t stride;   // interleaved channels of a written block
+  _Atomic uint64_t claimed;
+  _Atomic uint64_t written;
+  _Atomic uint64_t consumed;
+  uint64_t first; // no frame before it is in samples, set by ringMove
+
+  // Written by the producer only
+  _Atomic uint64_t writes;
+  _Atomic uint64_t droppedFrames;
+  _Atomic uint64_t droppedWrites; // writes that dropped at least one frame
+
+  RingStamp stamps[RING_STAMPS]; // ring of the newest stamps
+  _Atomic uint64_t stamped;      // stamps written since the reset
+} Ring;
+
+typedef struct {
+  uint64_t writes;
+  uint64_t frames;
+  uint64_t droppedFrames; // overwritten before they were consumed
+  uint64_t droppedWrites;
+} RingStats;
+
+// `samples` must hold capacity * min(stride, RING_MAX_CHANNELS) floats.
+// Fails if capacity is not a power of two or stride is 0. Streams with more
+// than RING_MAX_CHANNELS channels only keep the first ones.
+bool ringInit(Ring *ring, float samples[], const size_t capacity,
+              const size_t stride);
+
+// Forgets all frames and statistics. Only while there is no producer.
+void ringReset(Ring *ring);
+
+// Moves the ring to `samples` of `capacity` frames (a power of two), which
+// must hold capacity * channels floats. Keeps the newest frames that fit,
+// their indices, the stamps and the statistics. The old samples are the
+// caller's to free. Only while there is neither a producer nor a reader.
+bool ringMove(Ring *ring, float samples[], const size_t capacity);
+
+// Producer side. Appends `frames` interleaved frames of `stride` floats that
+// were produced at `time` seconds (of any monotonic clock); of a block larger
+// than the ring only the last `capacity` frames are kept.
+void ringWrite(Ring *ring, const float samples[], size_t frames,
+               const double time);
+
+// Number of frames written since the reset, the index after the newest one.
+uint64_t ringWritten(const Ring *ring);
+
+// Index of the oldest frame that has not been overwritten yet.
+uint64_t ringOldest(const Ring *ring);
+
+// Reader side. Marks the frames before `frame` as processed, they may be
+// overwritten without counting as dropped. Never moves backwards.
+void ringConsume(Ring *ring, const uint64_t frame);
+
+RingStats ringStats(const Ring *ring);
+
+// The stamp of the newest write. Fails if nothing was written yet.
+bool ringLatestStamp(const Ring *ring, RingStamp *stamp);
+
+// Copies one channel of the frames [start, start + frames). Fails if a part
+// of them is not written yet or has been overwritten.
+bool ringReadChannel(const Ring *ring, const size_t channel,
+                     const uint64_t start, const size_t frames, float out[]);
+
+// Like ringReadChannel, but writes the sum of the channels times
+// weights[channel], e.g. {0.5, 0.5} for the mid and {0.5, -0.5} for the side
+// of a stereo stream.
+bool ringReadMix(const Ring *ring, const float weights[], const uint64_t start,
+                 const size_t frames, float out[]);
+
+#endif // RING_H
@@ -0,0 +1,258 @@
+#include "ring.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CAPACITY ((size_t)1 << 15) // as FRAME_BUFFER_CAPACITY
+#define CHANNELS 2
+#define BLOCK 480    // 10 ms at 48 kHz
+#define WINDOW 16384 // as ANALYSIS_WINDOW
+#define HOP 1024
+#define SECONDS 1.0
+#define SPEEDUP 10 // blocks are written ten times faster than real time
+#define HAMMERS 3  // extra threads that read random windows
+
+static float storage[CAPACITY * RING_MAX_CHANNELS];
+static Ring ring;
+static _Atomic int producing = 1;
+static _Atomic unsigned long tornWindows = 0;
+
+// Frame i holds i in the left and -i in the right channel (exact in a float
+// below 2^24)
+static inline float frameValue(const uint64_t i) {
+  return (float)(i % (1 << 24));
+}
+
+static void sleepMicroseconds(const long us) {
+  const struct timespec t = {.tv_sec = us / 1000000,
+                             .tv_nsec = (us % 1000000) * 1000};
+  nanosleep(&t, NULL);
+}
+
+// The audio callback
+static void *produce(void *arg) {
+  (void)arg;
+  float block[BLOCK * CHANNELS];
+  const long blocks = SECONDS * 48000 * SPEEDUP / BLOCK;
+  uint64_t frame = 0;
+  for (long b = 0; b < blocks; ++b) {
+    for (size_t i = 0; i < BLOCK; ++i, ++frame) {
+      block[i * CHANNELS] = frameValue(frame);
+      block[i * CHANNELS + 1] = -frameValue(frame);
+    }
+    ringWrite(&ring, block, BLOCK, b * 0.01);
+    sleepMicroseconds(10000 / SPEEDUP);
+  }
+  atomic_store(&producing, 0);
+  return NULL;
+}
+
+static bool windowIsValid(const float window[], const uint64_t start,
+                          const size_t frames, const float sign) {
+  for (size_t i = 0; i < frames; ++i)
+    if (window[i] != sign * frameValue(start + i))
+      return false;
+  return true;
+}
+
+// Reads random windows as fast as it can, which only makes the consumer
+// compete for the cache
+static void *hammer(void *arg) {
+  unsigned int seed = (unsigned int)(size_t)arg;
+  static _Thread_local float window[WINDOW];
+  while (atomic_load(&producing)) {
+    const uint64_t written = ringWritten(&ring);
+    if (written < WINDOW)
+      continue;
+    const uint64_t kept = written < CAPACITY ? written : CAPACITY;
+    const uint64_t start =
+        written - WINDOW - rand_r(&seed) % (kept - WINDOW + 1);
+    if (ringReadChannel(&ring, 1, start, WINDOW, window) &&
+        !windowIsValid(window, start, WINDOW, -1.0f))
+      atomic_fetch_add(&tornWindows, 1);
+  }
+  return NULL;
+}
+
+// The analysis: one window per hop, in order, consuming what it analyzed
+static unsigned long consume(void) {
+  static float window[WINDOW];
+  unsigned long hops = 0;
+  uint64_t next = WINDOW;
+  while (atomic_load(&producing) || next <= ringWritten(&ring)) {
+    if (next > ringWritten(&ring))
+      continue;
+    if (!ringReadChannel(&ring, 0, next - WINDOW, WINDOW, window))
+      break; // overwritten, the statistics will show it
+    if (!windowIsValid(window, next - WINDOW, WINDOW, 1.0f))
+      atomic_fetch_add(&tornWindows, 1);
+    ringConsume(&ring, next);
+    next += HOP;
+    ++hops;
+  }
+  return hops;
+}
+
+// Writes frames in odd-sized blocks so that they wrap, then checks every
+// channel and a weighted mix of all of them. Sample c of frame i is
+// i + 1000 * c.
+static bool layoutIsValid(const size_t stride) {
+  static float block[1000 * 16];
+  static float out[CAPACITY];
+  ringInit(&ring, storage, CAPACITY, stride);
+  uint64_t frame = 0;
+  while (frame < 3 * CAPACITY) {
+    for (size_t i = 0; i < 1000; ++i)
+      for (size_t c = 0; c < stride; ++c)
+        block[i * stride + c] = (frame + i) % 1000 + 1000.0f * c;
+    ringWrite(&ring, block, 1000, 0.0);
+    frame += 1000;
+  }
+
+  const size_t frames = CAPACITY / 2 + 3;
+  const uint64_t start = frame - CAPACITY + 7;
+  for (size_t c = 0; c < ring.channels; ++c) {
+    if (!ringReadChannel(&ring, c, start, frames, out))
+      return false;
+    for (size_t i = 0; i < frames; ++i)
+      if (out[i] != (start + i) % 1000 + 1000.0f * c)
+        return false;
+  }
+
+  float weights[RING_MAX_CHANNELS], offset = 0.0f, sum = 0.0f;
+  for (size_t c = 0; c < ring.channels; ++c) {
+    weights[c] = c % 2 == 0 ? 0.5f : -0.25f;
+    offset += weights[c] * 1000.0f * c;
+    sum += weights[c];
+  }
+  if (!ringReadMix(&ring, weights, start, frames, out))
+    return false;
+  for (size_t i = 0; i < frames; ++i)
+    if (out[i] != sum * ((start + i) % 1000) + offset)
+      return false;
+  return ring.channels == (stride < RING_MAX_CHANNELS ? stride
+                                                      : RING_MAX_CHANNELS);
+}
+
+// Moves a full ring to `capacity` frames and checks that the newest frames
+// are still where their indices say, and that it goes on from there
+static bool moveIsValid(const size_t capacity) {
+  static float moved[2 * CAPACITY * CHANNELS];
+  static float block[BLOCK * CHANNELS];
+  static float out[CAPACITY];
+  ringInit(&ring, storage, CAPACITY, CHANNELS);
+  uint64_t frame = 0;
+  for (; frame < 2 * CAPACITY; frame += BLOCK) {
+    for (size_t i = 0; i < BLOCK; ++i) {
+      block[i * CHANNELS] = frameValue(frame + i);
+      block[i * CHANNELS + 1] = -frameValue(frame + i);
+    }
+    ringWrite(&ring, block, BLOCK, 0.0);
+  }
+  const RingStats before = ringStats(&ring);
+  if (!ringMove(&ring, moved, capacity))
+    return false;
+  const RingStats after = ringStats(&ring);
+  if (after.frames != before.frames || after.writes != before.writes)
+    return false;
+
+  const size_t kept = capacity < CAPACITY ? capacity : CAPACITY;
+  if (!ringReadChannel(&ring, 1, frame - kept, kept, out) ||
+      !windowIsValid(out, frame - kept, kept, -1.0f))
+    return false;
+  if (capacity > CAPACITY &&
+      ringReadChannel(&ring, 0, frame - CAPACITY - 1, CAPACITY + 1, out))
+    return false; // those were gone before the move
+
+  for (size_t i = 0; i < BLOCK; ++i) {
+    block[i * CHANNELS] = frameValue(frame + i);
+    block[i * CHANNELS + 1] = -frameValue(frame + i);
+  }
+  ringWrite(&ring, block, BLOCK, 0.0);
+  frame += BLOCK;
+  return ringReadChannel(&ring, 0, frame - kept, kept, out) &&
+         windowIsValid(out, frame - kept, kept, 1.0f);
+}
+
+int main(void) {
+  int failed = 0;
+
+  printf("======= LAYOUTS =======\n");
+  const size_t strides[] = {1, 2, 6, 8, 11};
+  for (size_t i = 0; i < sizeof(strides) / sizeof(strides[0]); ++i) {
+    const bool valid = layoutIsValid(strides[i]);
+    printf("%zu channels: %s\n", strides[i], valid ? "ok" : "FAILED");
+    failed |= !valid;
+  }
+
+  printf("======= MOVE =======\n");
+  const size_t capacities[] = {CAPACITY / 4, CAPACITY, 2 * CAPACITY};
+  for (size_t i = 0; i < sizeof(capacities) / sizeof(capacities[0]); ++i) {
+    const bool valid = moveIsValid(capacities[i]);
+    printf("%zu frames: %s\n", capacities[i], valid ? "ok" : "FAILED");
+    failed |= !valid;
+  }
+  ringInit(&ring, storage, CAPACITY, CHANNELS);
+
+  printf("======= STRESS =======\n");
+  pthread_t producer, hammers[HAMMERS];
+  pthread_create(&producer, NULL, produce, NULL);
+  for (size_t i = 0; i < HAMMERS; ++i)
+    pthread_create(&hammers[i], NULL, hammer, (void *)(i + 1));
+  const unsigned long hops = consume();
+  pthread_join(producer, NULL);
+  for (size_t i = 0; i < HAMMERS; ++i)
+    pthread_join(hammers[i], NULL);
+
+  RingStats stats = ringStats(&ring);
+  printf("%llu frames in %llu writes, %lu hops analyzed\n",
+         (unsigned long long)stats.frames, (unsigned long long)stats.writes,
+         hops);
+  printf("Dropped %llu frames in %llu writes, %lu torn windows\n",
+         (unsigned long long)stats.droppedFrames,
+         (unsigned long long)stats.droppedWrites, atomic_load(&tornWindows));
+  failed |= stats.droppedFrames != 0 || atomic_load(&tornWindows) != 0;
+  failed |= hops != (stats.frames - WINDOW) / HOP + 1;
+
+  printf("======= ACCOUNTING =======\n");
+  // A reader that stops consuming loses exactly what is overwritten
+  ringReset(&ring);
+  float block[BLOCK * CHANNELS] = {0};
+  const size_t blocks = CAPACITY / BLOCK + 10;
+  for (size_t b = 0; b < blocks; ++b)
+    ringWrite(&ring, block, BLOCK, b * 0.01);
+  stats = ringStats(&ring);
+  const uint64_t expected = blocks * BLOCK - CAPACITY;
+  printf("Dropped %llu frames in %llu writes (expected %llu)\n",
+         (unsigned long long)stats.droppedFrames,
+         (unsigned long long)stats.droppedWrites,
+         (unsigned long long)expected);
+  failed |= stats.droppedFrames != expected;
+  failed |= stats.droppedWrites != blocks - CAPACITY / BLOCK;
+
+  printf("======= STAMPS =======\n");
+  // A callback that is split into several writes is one burst
+  ringReset(&ring);
+  RingStamp stamp;
+  failed |= ringLatestStamp(&ring, &stamp);
+  ringWrite(&ring, block, BLOCK, 1.0);
+  ringWrite(&ring, block, 100, 1.0002);
+  ringWrite(&ring, block, 20, 1.0004);
+  failed |= !ringLatestStamp(&ring, &stamp);
+  printf("Burst of %llu frames up to %llu at %.4f s\n",
+         (unsigned long long)stamp.frames, (unsigned long long)stamp.frame,
+         stamp.time);
+  failed |= stamp.frames != BLOCK + 120 || stamp.frame != BLOCK + 120 ||
+            stamp.time != 1.0;
+  ringWrite(&ring, block, BLOCK, 1.01);
+  failed |= !ringLatestStamp(&ring, &stamp);
+  printf("Next burst of %llu frames up to %llu at %.4f s\n",
+         (unsigned long long)stamp.frames, (unsigned long long)stamp.frame,
+         stamp.time);
+  failed |= stamp.frames != BLOCK || stamp.frame != 2 * BLOCK + 120 ||
+            stamp.time != 1.01;
+
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
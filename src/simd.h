@@ -0,0 +1,176 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Minimal vector abstraction shared by the SIMD kernels. Uses AVX2 or SSE2
+// on x86_64 and SIMD128 on WASM (build with -msimd128).
+
+#define FLOAT_MANTISSA_MASK 0x007fffff
+#define FLOAT_ONE_BITS 0x3f800000
+#define FLOAT_EXPONENT_BIAS 127
+#define FLOAT_MANTISSA_BITS 23
+
+// Every vector backend defines the same small set of operations on `vf`, a
+// vector of VF_WIDTH floats. VF_WIDTH stays undefined without a backend, and
+// users keep a scalar loop for that case and for the tail of their arrays.
+//
+// vfPower reads 2 * VF_WIDTH interleaved floats (VF_WIDTH complex numbers)
+// and returns re^2 + im^2 in bin order. vfDeinterleave splits 2 * VF_WIDTH
+// interleaved floats (VF_WIDTH stereo frames) into the even and the odd
+// ones. vfSelectGreater(a, b, x, y) returns
+// a > b ? x : y per lane. vfExponent and vfMantissa split positive normal
+// floats into their unbiased exponent (as float) and mantissa in [1, 2).
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+typedef __m256 vf;
+#define VF_WIDTH 8
+#define vfLoad _mm256_loadu_ps
+#define vfStore _mm256_storeu_ps
+#define vfSet _mm256_set1_ps
+#define vfAdd _mm256_add_ps
+#define vfSub _mm256_sub_ps
+#define vfMul _mm256_mul_ps
+#define vfMax _mm256_max_ps
+#define vfSqrt _mm256_sqrt_ps
+
+static inline vf vfPower(const float *x) {
+  const vf a = vfLoad(x);
+  const vf b = vfLoad(x + VF_WIDTH);
+  // hadd works per 128 bit lane: [a01 b01 | a23 b23], swap the middle halves
+  const vf s = _mm256_hadd_ps(vfMul(a, a), vfMul(b, b));
+  return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(s),
+                                                _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+static inline void vfDeinterleave(const float *x, vf *even, vf *odd) {
+  const vf a = vfLoad(x);
+  const vf b = vfLoad(x + VF_WIDTH);
+  // Per 128 bit lane: [a0 a2 b0 b2 | a4 a6 b4 b6], swap the middle halves
+  *even = _mm256_castpd_ps(_mm256_permute4x64_pd(
+      _mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))),
+      _MM_SHUFFLE(3, 1, 2, 0)));
+  *odd = _mm256_castpd_ps(_mm256_permute4x64_pd(
+      _mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))),
+      _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+static inline vf vfSelectGreater(const vf a, const vf b, const vf x,
+                                 const vf y) {
+  return _mm256_blendv_ps(y, x, _mm256_cmp_ps(a, b, _CMP_GT_OQ));
+}
+
+static inline vf vfExponent(const vf x) {
+  const __m256i bits = _mm256_castps_si256(x);
+  return _mm256_cvtepi32_ps(
+      _mm256_sub_epi32(_mm256_srli_epi32(bits, FLOAT_MANTISSA_BITS),
+                       _mm256_set1_epi32(FLOAT_EXPONENT_BIAS)));
+}
+
+static inline vf vfMantissa(const vf x) {
+  const __m256i bits = _mm256_castps_si256(x);
+  return _mm256_castsi256_ps(
+      _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(FLOAT_MANTISSA_MASK)),
+                      _mm256_set1_epi32(FLOAT_ONE_BITS)));
+}
+
+#elif defined(__SSE2__)
+
+#include <emmintrin.h>
+
+typedef __m128 vf;
+#define VF_WIDTH 4
+#define vfLoad _mm_loadu_ps
+#define vfStore _mm_storeu_ps
+#define vfSet _mm_set1_ps
+#define vfAdd _mm_add_ps
+#define vfSub _mm_sub_ps
+#define vfMul _mm_mul_ps
+#define vfMax _mm_max_ps
+#define vfSqrt _mm_sqrt_ps
+
+static inline vf vfPower(const float *x) {
+  const vf a = vfLoad(x);
+  const vf b = vfLoad(x + VF_WIDTH);
+  const vf a2 = vfMul(a, a);
+  const vf b2 = vfMul(b, b);
+  return vfAdd(_mm_shuffle_ps(a2, b2, _MM_SHUFFLE(2, 0, 2, 0)),
+               _mm_shuffle_ps(a2, b2, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+static inline void vfDeinterleave(const float *x, vf *even, vf *odd) {
+  const vf a = vfLoad(x);
+  const vf b = vfLoad(x + VF_WIDTH);
+  *even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+  *odd = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+}
+
+static inline vf vfSelectGreater(const vf a, const vf b, const vf x,
+                                 const vf y) {
+  const vf mask = _mm_cmpgt_ps(a, b);
+  return _mm_or_ps(_mm_and_ps(mask, x), _mm_andnot_ps(mask, y));
+}
+
+static inline vf vfExponent(const vf x) {
+  const __m128i bits = _mm_castps_si128(x);
+  return _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, FLOAT_MANTISSA_BITS),
+                                       _mm_set1_epi32(FLOAT_EXPONENT_BIAS)));
+}
+
+static inline vf vfMantissa(const vf x) {
+  const __m128i bits = _mm_castps_si128(x);
+  return _mm_castsi128_ps(
+      _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(FLOAT_MANTISSA_MASK)),
+                   _mm_set1_epi32(FLOAT_ONE_BITS)));
+}
+
+#elif defined(__wasm_simd128__)
+
+#include <wasm_simd128.h>
+
+typedef v128_t vf;
+#define VF_WIDTH 4
+#define vfLoad wasm_v128_load
+#define vfStore wasm_v128_store
+#define vfSet wasm_f32x4_splat
+#define vfAdd wasm_f32x4_add
+#define vfSub wasm_f32x4_sub
+#define vfMul wasm_f32x4_mul
+#define vfMax wasm_f32x4_max
+#define vfSqrt wasm_f32x4_sqrt
+
+static inline vf vfPower(const float *x) {
+  const vf a = vfLoad(x);
+  const vf b = vfLoad(x + VF_WIDTH);
+  const vf a2 = vfMul(a, a);
+  const vf b2 = vfMul(b, b);
+  return vfAdd(wasm_i32x4_shuffle(a2, b2, 0, 2, 4, 6),
+               wasm_i32x4_shuffle(a2, b2, 1, 3, 5, 7));
+}
+
+static inline void vfDeinterleave(const float *x, vf *even, vf *odd) {
+  const vf a = vfLoad(x);
+  const vf b = vfLoad(x + VF_WIDTH);
+  *even = wasm_i32x4_shuffle(a, b, 0, 2, 4, 6);
+  *odd = wasm_i32x4_shuffle(a, b, 1, 3, 5, 7);
+}
+
+static inline vf vfSelectGreater(const vf a, const vf b, const vf x,
+                                 const vf y) {
+  return wasm_v128_bitselect(x, y, wasm_f32x4_gt(a, b));
+}
+
+static inline vf vfExponent(const vf x) {
+  return wasm_f32x4_convert_i32x4(
+      wasm_i32x4_sub(wasm_u32x4_shr(x, FLOAT_MANTISSA_BITS),
+                     wasm_i32x4_splat(FLOAT_EXPONENT_BIAS)));
+}
+
+static inline vf vfMantissa(const vf x) {
+  return wasm_v128_or(wasm_v128_and(x, wasm_i32x4_splat(FLOAT_MANTISSA_MASK)),
+                      wasm_i32x4_splat(FLOAT_ONE_BITS));
+}
+
+#endif // backends
+
+#endif // SIMD_H
@@ -0,0 +1,117 @@
+#include "spectrum.h"
+#include "simd.h"
+#include <float.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// log2(1 + t) ~ t * P(t) for t in [0, 1), Chebyshev fit of log2(1 + t) / t.
+#define LOG2_C0 1.4426814680651516f
+#define LOG2_C1 -0.720358772675779f
+#define LOG2_C2 0.46865887914367105f
+#define LOG2_C3 -0.30163800973500726f
+#define LOG2_C4 0.14447109569877475f
+#define LOG2_C5 -0.03382204596895592f
+
+#define LN2 0.69314718055994531f
+#define DECIBEL_PER_NEPER 4.3429448190325183f // 10 / ln(10)
+
+#ifdef VF_WIDTH
+static inline vf vfLog(vf x) {
+  x = vfMax(x, vfSet(FLT_MIN));
+  const vf e = vfExponent(x);
+  const vf t = vfAdd(vfMantissa(x), vfSet(-1.0f));
+  vf p = vfSet(LOG2_C5);
+  p = vfAdd(vfMul(p, t), vfSet(LOG2_C4));
+  p = vfAdd(vfMul(p, t), vfSet(LOG2_C3));
+  p = vfAdd(vfMul(p, t), vfSet(LOG2_C2));
+  p = vfAdd(vfMul(p, t), vfSet(LOG2_C1));
+  p = vfAdd(vfMul(p, t), vfSet(LOG2_C0));
+  return vfMul(vfAdd(e, vfMul(t, p)), vfSet(LN2));
+}
+#endif // VF_WIDTH
+
+float fastLogf(float x) {
+  if (!(x > FLT_MIN))
+    x = FLT_MIN;
+  union {
+    float f;
+    uint32_t u;
+  } bits = {.f = x};
+  const float e = (float)((int32_t)(bits.u >> FLOAT_MANTISSA_BITS) -
+                          FLOAT_EXPONENT_BIAS);
+  bits.u = (bits.u & FLOAT_MANTISSA_MASK) | FLOAT_ONE_BITS;
+  const float t = bits.f - 1.0f;
+  float p = LOG2_C5;
+  p = p * t + LOG2_C4;
+  p = p * t + LOG2_C3;
+  p = p * t + LOG2_C2;
+  p = p * t + LOG2_C1;
+  p = p * t + LOG2_C0;
+  return (e + t * p) * LN2;
+}
+
+static inline float logFactor(const SpectrumKind kind,
+                              const SpectrumScale scale) {
+  if (scale == SPECTRUM_DECIBEL)
+    return DECIBEL_PER_NEPER; // the same for magnitude and power
+  return kind == SPECTRUM_MAGNITUDE ? 0.5f : 1.0f; // ln|X| = 0.5 * ln|X|^2
+}
+
+void spectrum(const float complex in[], float out[], const size_t n,
+              const SpectrumKind kind, const SpectrumScale scale) {
+  const float *x = (const float *)in; // C11 guarantees {re, im} layout
+  const bool linear = scale == SPECTRUM_LINEAR;
+  const bool root = kind == SPECTRUM_MAGNITUDE;
+  const float factor = logFactor(kind, scale);
+  size_t i = 0;
+
+#ifdef VF_WIDTH
+  for (; i + VF_WIDTH <= n; i += VF_WIDTH) {
+    vf p = vfPower(&x[2 * i]);
+    if (linear)
+      p = root ? vfSqrt(p) : p;
+    else
+      p = vfMul(vfLog(p), vfSet(factor));
+    vfStore(&out[i], p);
+  }
+#endif // VF_WIDTH
+
+  for (; i < n; ++i) {
+    const float p = x[2 * i] * x[2 * i] + x[2 * i + 1] * x[2 * i + 1];
+    if (linear)
+      out[i] = root ? sqrtf(p) : p;
+    else
+      out[i] = fastLogf(p) * factor;
+  }
+}
+
+void spectrumLog(const float in[], float out[], const size_t n) {
+  size_t i = 0;
+
+#ifdef VF_WIDTH
+  for (; i + VF_WIDTH <= n; i += VF_WIDTH)
+    vfStore(&out[i], vfLog(vfLoad(&in[i])));
+#endif // VF_WIDTH
+
+  for (; i < n; ++i)
+    out[i] = fastLogf(in[i]);
+}
+
+float spectrumDot(const float a[], const float b[], const size_t n) {
+  float sum = 0.0f;
+  size_t i = 0;
+
+#ifdef VF_WIDTH
+  vf acc = vfSet(0.0f);
+  for (; i + VF_WIDTH <= n; i += VF_WIDTH)
+    acc = vfAdd(acc, vfMul(vfLoad(&a[i]), vfLoad(&b[i])));
+  float lanes[VF_WIDTH];
+  vfStore(lanes, acc);
+  for (size_t l = 0; l < VF_WIDTH; ++l)
+    sum += lanes[l];
+#endif // VF_WIDTH
+
+  for (; i < n; ++i)
+    sum += a[i] * b[i];
+  return sum;
+}
@@ -0,0 +1,43 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <complex.h>
+#include <math.h>
+#include <stddef.h>
+
+// Vectorized post-processing of an FFT output. Uses AVX2 or SSE2 on x86_64
+// and SIMD128 on WASM (build with -msimd128), with a scalar fallback.
+//
+// The logarithm is a polynomial approximation (range reduction on the float
+// exponent plus a degree 6 polynomial on the mantissa). Maximum absolute
+// error over all positive normal floats:
+//   natural log:  < 2.0e-5 (dominated by float rounding for large |ln x|)
+//   decibel:      < 5.0e-5 dB
+// Inputs <= FLT_MIN are clamped to FLT_MIN, so log(0) = ln(FLT_MIN) ~ -87.3.
+// See spectrum_test.c for the measurement and the benchmark against libm.
+
+typedef enum {
+  SPECTRUM_MAGNITUDE, // |X[k]|
+  SPECTRUM_POWER,     // |X[k]|^2
+} SpectrumKind;
+
+typedef enum {
+  SPECTRUM_LINEAR,  // no scaling
+  SPECTRUM_LOG,     // natural logarithm
+  SPECTRUM_DECIBEL, // 20 * log10(|X[k]|) == 10 * log10(|X[k]|^2)
+} SpectrumScale;
+
+// Computes magnitude or power of n bins and scales them in a single pass.
+void spectrum(const float complex in[], float out[], const size_t n,
+              const SpectrumKind kind, const SpectrumScale scale);
+
+// Fast natural logarithm of n values, e.g. for already bucketed magnitudes.
+void spectrumLog(const float in[], float out[], const size_t n);
+
+// Dot product of two float vectors, e.g. one row of a filter matrix.
+float spectrumDot(const float a[], const float b[], const size_t n);
+
+// Scalar version of the approximation used by the vector kernels.
+float fastLogf(float x);
+
+#endif // SPECTRUM_H
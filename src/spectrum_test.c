@@ -0,0 +1,117 @@
+#include "spectrum.h"
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define P ((size_t)1 << 14)
+#define RUNS 2000
+
+#define MAX_LOG_ERROR 2.0e-5
+#define MAX_DECIBEL_ERROR 5.0e-5
+
+static float complex bins[P];
+static float out[P];
+static float reference[P];
+
+static inline float randomFloat(void) { return (float)rand() / RAND_MAX; }
+
+static inline int milliseconds(clock_t diff) {
+  return diff * 1000 / CLOCKS_PER_SEC;
+}
+
+int main(void) {
+  int failed = 0;
+
+  printf("======= ACCURACY =======\n");
+
+  // Sweep every exponent of the positive normal floats with random mantissas.
+  double maxLogError = 0.0;
+  for (int e = FLT_MIN_EXP; e < FLT_MAX_EXP; ++e) {
+    for (size_t i = 0; i < P; ++i)
+      reference[i] = ldexpf(1.0f + randomFloat() * (1.0f - FLT_EPSILON), e - 1);
+    spectrumLog(reference, out, P);
+    for (size_t i = 0; i < P; ++i) {
+      const double err = fabs(out[i] - log((double)reference[i]));
+      maxLogError = err > maxLogError ? err : maxLogError;
+      if (out[i] != fastLogf(reference[i])) {
+        printf("Vector and scalar log differ at %g\n", reference[i]);
+        failed = 1;
+      }
+    }
+  }
+  printf("Max natural log error: %g (bound %g)\n", maxLogError, MAX_LOG_ERROR);
+  failed |= maxLogError >= MAX_LOG_ERROR;
+
+  for (size_t i = 0; i < P; ++i)
+    bins[i] = (randomFloat() - 0.5f) * 100.0f +
+              (randomFloat() - 0.5f) * 100.0f * I;
+
+  double maxMagnitudeError = 0.0;
+  spectrum(bins, out, P, SPECTRUM_MAGNITUDE, SPECTRUM_LINEAR);
+  for (size_t i = 0; i < P; ++i) {
+    const double err = fabs(out[i] - cabs((double complex)bins[i]));
+    maxMagnitudeError = err > maxMagnitudeError ? err : maxMagnitudeError;
+  }
+  printf("Max magnitude error: %g\n", maxMagnitudeError);
+  failed |= maxMagnitudeError >= 1.0e-4;
+
+  double maxDecibelError = 0.0;
+  spectrum(bins, out, P, SPECTRUM_MAGNITUDE, SPECTRUM_DECIBEL);
+  for (size_t i = 0; i < P; ++i) {
+    const double err = fabs(out[i] - 20.0 * log10(cabs((double complex)bins[i])));
+    maxDecibelError = err > maxDecibelError ? err : maxDecibelError;
+  }
+  printf("Max decibel error: %g dB (bound %g)\n", maxDecibelError,
+         MAX_DECIBEL_ERROR);
+  failed |= maxDecibelError >= MAX_DECIBEL_ERROR;
+
+  printf("\n====== PERFORMANCE ======\n");
+  printf("Spectrum length: %ld bins, %d runs\n", P, RUNS);
+
+  clock_t start, diff;
+  float sum = 0.0f; // keeps the compiler from dropping the loops
+
+  printf("======= libm cabsf + logf =======\n");
+  start = clock();
+  for (int r = 0; r < RUNS; ++r) {
+    for (size_t i = 0; i < P; ++i)
+      out[i] = logf(cabsf(bins[i]));
+    sum += out[r];
+  }
+  diff = clock() - start;
+  printf("Time taken %d milliseconds\n", milliseconds(diff));
+
+  printf("======= spectrum (magnitude, log) =======\n");
+  start = clock();
+  for (int r = 0; r < RUNS; ++r) {
+    spectrum(bins, out, P, SPECTRUM_MAGNITUDE, SPECTRUM_LOG);
+    sum += out[r];
+  }
+  diff = clock() - start;
+  printf("Time taken %d milliseconds\n", milliseconds(diff));
+
+  printf("======= libm cabsf =======\n");
+  start = clock();
+  for (int r = 0; r < RUNS; ++r) {
+    for (size_t i = 0; i < P; ++i)
+      out[i] = cabsf(bins[i]);
+    sum += out[r];
+  }
+  diff = clock() - start;
+  printf("Time taken %d milliseconds\n", milliseconds(diff));
+
+  printf("======= spectrum (magnitude, linear) =======\n");
+  start = clock();
+  for (int r = 0; r < RUNS; ++r) {
+    spectrum(bins, out, P, SPECTRUM_MAGNITUDE, SPECTRUM_LINEAR);
+    sum += out[r];
+  }
+  diff = clock() - start;
+  printf("Time taken %d milliseconds\n", milliseconds(diff));
+  printf("(checksum %g)\n", sum);
+
+  if (failed)
+    printf("\nFAILED: error bounds exceeded\n");
+  return failed;
+}
@@ -0,0 +1,134 @@
+#include "timing.h"
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+
+static size_t bucketOf(const uint64_t value) {
+  if (value == 0)
+    return 0;
+  const size_t bits = 64 - __builtin_clzll(value);
+  return bits < HISTOGRAM_BUCKETS ? bits : HISTOGRAM_BUCKETS - 1;
+}
+
+static uint64_t bucketLow(const size_t b) {
+  return b == 0 ? 0 : (uint64_t)1 << (b - 1);
+}
+
+static uint64_t bucketHigh(const size_t b, const uint64_t max) {
+  if (b == 0)
+    return 0;
+  const uint64_t high = ((uint64_t)1 << b) - 1;
+  return b < HISTOGRAM_BUCKETS - 1 && high < max ? high : max;
+}
+
+void histogramReset(Histogram *h) {
+  for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b)
+    atomic_store_explicit(&h->buckets[b], 0, memory_order_relaxed);
+  atomic_store_explicit(&h->sum, 0, memory_order_relaxed);
+  atomic_store_explicit(&h->max, 0, memory_order_relaxed);
+}
+
+// Plain loads and stores, there is only one writer
+static inline void increase(_Atomic uint64_t *counter, const uint64_t by) {
+  const uint64_t value = atomic_load_explicit(counter, memory_order_relaxed);
+  atomic_store_explicit(counter, value + by, memory_order_relaxed);
+}
+
+void histogramAdd(Histogram *h, const uint64_t value) {
+  increase(&h->buckets[bucketOf(value)], 1);
+  increase(&h->sum, value);
+  if (value > atomic_load_explicit(&h->max, memory_order_relaxed))
+    atomic_store_explicit(&h->max, value, memory_order_relaxed);
+}
+
+// The bucket that holds the value at `q` of `count` values
+static size_t quantileBucket(const uint64_t buckets[], const uint64_t count,
+                             const double q) {
+  const uint64_t rank = ceil(q * count);
+  uint64_t seen = 0;
+  for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+    seen += buckets[b];
+    if (seen >= rank && seen > 0)
+      return b;
+  }
+  return 0;
+}
+
+HistogramSummary histogramSummary(const Histogram *h) {
+  uint64_t buckets[HISTOGRAM_BUCKETS];
+  uint64_t count = 0;
+  for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+    buckets[b] = atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+    count += buckets[b];
+  }
+  const uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+  if (count == 0)
+    return (HistogramSummary){0};
+  return (HistogramSummary){
+      .count = count,
+      .mean = (double)atomic_load_explicit(&h->sum, memory_order_relaxed) /
+              count,
+      .p50 = bucketHigh(quantileBucket(buckets, count, 0.5), max),
+      .p99 = bucketHigh(quantileBucket(buckets, count, 0.99), max),
+      .max = max,
+  };
+}
+
+void histogramPrint(const Histogram *h, FILE *out, const char *name,
+                    const char *unit) {
+  const HistogramSummary s = histogramSummary(h);
+  fprintf(out,
+          "  %s (%s): %" PRIu64 " values, mean %.1f, p50 <= %" PRIu64
+          ", p99 <= %" PRIu64 ", max %" PRIu64 "\n",
+          name, unit, s.count, s.mean, s.p50, s.p99, s.max);
+  for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+    const uint64_t n =
+        atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+    if (n == 0)
+      continue;
+    if (b == HISTOGRAM_BUCKETS - 1)
+      fprintf(out, "    >= %" PRIu64 ": %" PRIu64 "\n", bucketLow(b), n);
+    else
+      fprintf(out, "    [%" PRIu64 ", %" PRIu64 "): %" PRIu64 "\n",
+              bucketLow(b), b == 0 ? 1 : (uint64_t)1 << b, n);
+  }
+}
+
+uint64_t timingNow(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+void callTimingReset(CallTiming *t) {
+  histogramReset(&t->interval);
+  histogramReset(&t->frames);
+  histogramReset(&t->busy);
+  atomic_store_explicit(&t->underruns, 0, memory_order_relaxed);
+  t->previous = 0;
+}
+
+void callTimingRestart(CallTiming *t) { t->previous = 0; }
+
+uint64_t callTimingRecord(CallTiming *t, const uint64_t start,
+                          const uint64_t end, const uint64_t frames) {
+  const uint64_t interval = t->previous > 0 ? start - t->previous : 0;
+  if (t->previous > 0)
+    histogramAdd(&t->interval, interval);
+  t->previous = start;
+  histogramAdd(&t->frames, frames);
+  histogramAdd(&t->busy, end - start);
+  return interval;
+}
+
+void callTimingUnderrun(CallTiming *t) {
+  atomic_fetch_add_explicit(&t->underruns, 1, memory_order_relaxed);
+}
+
+void callTimingPrint(const CallTiming *t, FILE *out, const char *name) {
+  fprintf(out, "%s: %" PRIu64 " underruns\n", name,
+          atomic_load_explicit(&t->underruns, memory_order_relaxed));
+  histogramPrint(&t->interval, out, "interval", "us");
+  histogramPrint(&t->frames, out, "frames", "frames");
+  histogramPrint(&t->busy, out, "busy", "us");
+}
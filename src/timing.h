@@ -0,0 +1,72 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define HISTOGRAM_BUCKETS 32
+
+// Histogram of integer values in power of two buckets: bucket 0 holds 0,
+// bucket b holds [2^(b-1), 2^b), the last one everything above. One thread
+// adds values without a lock or a read-modify-write, any thread reads them.
+// A reader may see a value in its bucket but not yet in the sum, never a
+// torn counter.
+typedef struct {
+  _Atomic uint64_t buckets[HISTOGRAM_BUCKETS];
+  _Atomic uint64_t sum;
+  _Atomic uint64_t max;
+} Histogram;
+
+typedef struct {
+  uint64_t count;
+  double mean;
+  uint64_t p50; // upper bounds of the buckets of the quantiles, at most max
+  uint64_t p99;
+  uint64_t max;
+} HistogramSummary;
+
+// Only while nobody adds values.
+void histogramReset(Histogram *h);
+
+// Writer side.
+void histogramAdd(Histogram *h, const uint64_t value);
+
+HistogramSummary histogramSummary(const Histogram *h);
+
+// One line per non-empty bucket, indented under a line with the summary.
+void histogramPrint(const Histogram *h, FILE *out, const char *name,
+                    const char *unit);
+
+// The calls of a periodic function that runs on a real-time thread, e.g.
+// an audio callback: how far apart they start, how much they handle and how
+// long they take, in microseconds. The thread that makes the calls records
+// them, underruns may be counted by any thread.
+typedef struct {
+  Histogram interval; // from the start of the previous call
+  Histogram frames;
+  Histogram busy;
+  _Atomic uint64_t underruns;
+  uint64_t previous; // start of the previous call, 0 before the first
+} CallTiming;
+
+// Microseconds of a monotonic clock.
+uint64_t timingNow(void);
+
+// Only while nobody records calls.
+void callTimingReset(CallTiming *t);
+
+// Forgets when the previous call was, so that a pause between two runs of
+// the calls is not taken for an interval. Only while nobody records calls.
+void callTimingRestart(CallTiming *t);
+
+// Records a call that ran from `start` to `end` (timingNow) and handled
+// `frames`. Returns the interval since the previous call, 0 for the first.
+uint64_t callTimingRecord(CallTiming *t, const uint64_t start,
+                          const uint64_t end, const uint64_t frames);
+
+void callTimingUnderrun(CallTiming *t);
+
+void callTimingPrint(const CallTiming *t, FILE *out, const char *name);
+
+#endif // TIMING_H
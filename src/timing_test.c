@@ -0,0 +1,87 @@
+#include "timing.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define VALUES 2000000
+
+static Histogram histogram;
+static _Atomic int adding = 1;
+
+// The audio callback: 1..1000 over and over, so the mean is 500.5
+static void *add(void *arg) {
+  (void)arg;
+  for (uint64_t i = 0; i < VALUES; ++i)
+    histogramAdd(&histogram, i % 1000 + 1);
+  atomic_store(&adding, 0);
+  return NULL;
+}
+
+static bool summaryIs(const HistogramSummary s, const uint64_t count,
+                      const double mean, const uint64_t p50,
+                      const uint64_t p99, const uint64_t max) {
+  printf("%lu values, mean %.2f, p50 <= %lu, p99 <= %lu, max %lu\n",
+         (unsigned long)s.count, s.mean, (unsigned long)s.p50,
+         (unsigned long)s.p99, (unsigned long)s.max);
+  return s.count == count && s.mean > mean - 1e-9 && s.mean < mean + 1e-9 &&
+         s.p50 == p50 && s.p99 == p99 && s.max == max;
+}
+
+int main(void) {
+  int failed = 0;
+
+  histogramReset(&histogram);
+  failed |= !summaryIs(histogramSummary(&histogram), 0, 0.0, 0, 0, 0);
+  // 0, then one value in every bucket up to [512, 1024)
+  histogramAdd(&histogram, 0);
+  for (uint64_t v = 1; v < 1024; v *= 2)
+    histogramAdd(&histogram, v);
+  failed |= !summaryIs(histogramSummary(&histogram), 11, 1023.0 / 11, 31,
+                       512, 512);
+  // Beyond the last bucket
+  histogramAdd(&histogram, (uint64_t)1 << 40);
+  failed |= histogramSummary(&histogram).p99 != (uint64_t)1 << 40;
+
+  // Readers only ever see counts that grow and never a value that was not
+  // added
+  histogramReset(&histogram);
+  pthread_t writer;
+  if (pthread_create(&writer, NULL, add, NULL) != 0) {
+    fprintf(stderr, "Could not start the writer\n");
+    return EXIT_FAILURE;
+  }
+  uint64_t last = 0, reads = 0, shrunk = 0, invalid = 0;
+  while (atomic_load(&adding)) {
+    const HistogramSummary s = histogramSummary(&histogram);
+    if (s.count < last)
+      ++shrunk;
+    if (s.max > 1000 || s.p99 > 1000)
+      ++invalid;
+    last = s.count;
+    ++reads;
+  }
+  pthread_join(writer, NULL);
+  printf("%lu reads, %lu shrunk, %lu invalid\n", (unsigned long)reads,
+         (unsigned long)shrunk, (unsigned long)invalid);
+  failed |= shrunk > 0 || invalid > 0;
+  failed |= !summaryIs(histogramSummary(&histogram), VALUES, 500.5, 511,
+                       1000, 1000);
+
+  // Calls 10 ms apart, of which the first has no interval
+  CallTiming t;
+  callTimingReset(&t);
+  for (uint64_t i = 0; i < 5; ++i)
+    callTimingRecord(&t, 1000000 + i * 10000, 1000000 + i * 10000 + 100, 480);
+  callTimingRestart(&t);
+  failed |= callTimingRecord(&t, 5000000, 5000100, 480) != 0;
+  callTimingUnderrun(&t);
+  failed |= !summaryIs(histogramSummary(&t.interval), 4, 10000.0, 10000,
+                       10000, 10000);
+  failed |= !summaryIs(histogramSummary(&t.busy), 6, 100.0, 100, 100, 100);
+  failed |= atomic_load(&t.underruns) != 1;
+  callTimingPrint(&t, stdout, "calls");
+
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
@@ -0,0 +1,34 @@
+#include "triple.h"
+#include <string.h>
+
+#define TRIPLE_FRESH 4 // bit in `middle`, set by the writer, cleared on read
+
+void tripleInit(TripleBuffer *tb, void *storage, const size_t slotSize,
+                const void *initial) {
+  tb->slots = storage;
+  tb->slotSize = slotSize;
+  for (int i = 0; i < 3; ++i)
+    memcpy(&tb->slots[i * slotSize], initial, slotSize);
+  tb->back = 0;
+  tb->front = 2;
+  atomic_store_explicit(&tb->middle, 1, memory_order_release);
+}
+
+void *tripleBack(TripleBuffer *tb) {
+  return &tb->slots[tb->back * tb->slotSize];
+}
+
+void triplePublish(TripleBuffer *tb) {
+  const int previous = atomic_exchange_explicit(
+      &tb->middle, tb->back | TRIPLE_FRESH, memory_order_acq_rel);
+  tb->back = previous & ~TRIPLE_FRESH;
+}
+
+const void *tripleFront(TripleBuffer *tb) {
+  if (atomic_load_explicit(&tb->middle, memory_order_relaxed) & TRIPLE_FRESH) {
+    const int previous = atomic_exchange_explicit(&tb->middle, tb->front,
+                                                  memory_order_acq_rel);
+    tb->front = previous & ~TRIPLE_FRESH;
+  }
+  return &tb->slots[tb->front * tb->slotSize];
+}
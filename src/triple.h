@@ -0,0 +1,33 @@
+#ifndef TRIPLE_H
+#define TRIPLE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Lock-free triple buffer that hands the latest of a series of values from
+// one writer thread to one reader thread. The writer fills its back slot and
+// publishes it by swapping it with the middle one; the reader swaps the
+// middle slot into the front when it is newer. Neither side ever waits, the
+// reader always sees a complete value and skips the ones it was too slow
+// for.
+typedef struct {
+  unsigned char *slots;
+  size_t slotSize;
+  int back;           // owned by the writer
+  int front;          // owned by the reader
+  _Atomic int middle; // slot index, plus TRIPLE_FRESH until it is read
+} TripleBuffer;
+
+// `storage` must hold 3 * slotSize bytes. All slots start as a copy of
+// `initial`. Only while neither side is running.
+void tripleInit(TripleBuffer *tb, void *storage, const size_t slotSize,
+                const void *initial);
+
+// Writer side: the slot to fill, then publish it.
+void *tripleBack(TripleBuffer *tb);
+void triplePublish(TripleBuffer *tb);
+
+// Reader side: the latest published value, valid until the next call.
+const void *tripleFront(TripleBuffer *tb);
+
+#endif // TRIPLE_H
@@ -0,0 +1,64 @@
+#include "triple.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PUBLISHES 1000000
+#define VALUES 256 // a slot is only consistent if all of them are equal
+
+typedef struct {
+  unsigned long values[VALUES];
+} Slot;
+
+static Slot slots[3];
+static TripleBuffer tb;
+
+// The analysis
+static void *publish(void *arg) {
+  (void)arg;
+  for (unsigned long n = 1; n <= PUBLISHES; ++n) {
+    Slot *slot = tripleBack(&tb);
+    for (size_t i = 0; i < VALUES; ++i)
+      slot->values[i] = n;
+    triplePublish(&tb);
+  }
+  return NULL;
+}
+
+int main(void) {
+  const Slot initial = {0};
+  tripleInit(&tb, slots, sizeof(Slot), &initial);
+
+  pthread_t writer;
+  if (pthread_create(&writer, NULL, publish, NULL) != 0) {
+    fprintf(stderr, "Could not start the writer\n");
+    return EXIT_FAILURE;
+  }
+
+  // The renderer: every read must be a whole slot and never older than the
+  // previous one
+  unsigned long last = 0, reads = 0, torn = 0, stale = 0;
+  while (last < PUBLISHES) {
+    const Slot *slot = tripleFront(&tb);
+    const unsigned long n = slot->values[0];
+    for (size_t i = 1; i < VALUES; ++i)
+      if (slot->values[i] != n) {
+        ++torn;
+        break;
+      }
+    if (n < last)
+      ++stale;
+    last = n;
+    ++reads;
+  }
+  pthread_join(writer, NULL);
+
+  printf("%lu reads of %d publishes, %lu torn, %lu went back\n", reads,
+         PUBLISHES, torn, stale);
+  if (torn > 0 || stale > 0) {
+    fprintf(stderr, "FAILED\n");
+    return EXIT_FAILURE;
+  }
+  printf("OK\n");
+  return EXIT_SUCCESS;
+}